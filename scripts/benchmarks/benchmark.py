@@ -173,6 +173,10 @@ for cmd, dir, scene, nlambdas, spp in cmds:
 
     os.chdir(dir)
 
+    # the master writes its stats in a binary format
+    subprocess.run([os.path.join(build_path, 'r2t2-stats-to-csv'), '.'],
+                   check=True)
+
     if args.generate_static:
         subprocess.run(os.path.join(r2t2_scripts_path,
             "generate_static_assignment.sh") + " treelets.csv > STATIC0",
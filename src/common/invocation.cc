@@ -0,0 +1,87 @@
+#include "invocation.hh"
+
+#include "net/address.hh"
+#include "util/digest.hh"
+
+using namespace std;
+
+namespace r2t2 {
+
+vector<string> worker_command( const protobuf::InvocationPayload& payload,
+                               const string& program )
+{
+  const auto [coordinator_ip, coordinator_port]
+    = Address::decompose( payload.coordinator() );
+
+  vector<string> command { program,
+                           "--ip",
+                           coordinator_ip,
+                           "--port",
+                           to_string( coordinator_port ),
+                           "--storage-backend",
+                           payload.storage_backend(),
+                           "--max-depth",
+                           to_string( payload.max_path_depth() ) };
+
+  if ( payload.samples_per_pixel() ) {
+    command.insert( command.end(),
+                    { "--samples", to_string( payload.samples_per_pixel() ) } );
+  }
+
+  if ( payload.bagging_delay() ) {
+    command.insert(
+      command.end(),
+      { "--bagging-delay", to_string( payload.bagging_delay() ) } );
+  }
+
+  if ( payload.ray_log_rate() ) {
+    command.insert( command.end(),
+                    { "--log-rays", to_string( payload.ray_log_rate() ) } );
+  }
+
+  if ( payload.bag_log_rate() ) {
+    command.insert( command.end(),
+                    { "--log-bags", to_string( payload.bag_log_rate() ) } );
+  }
+
+  if ( payload.directional_treelets() ) {
+    command.push_back( "--directional" );
+  }
+
+  if ( payload.accumulators() ) {
+    command.insert( command.end(),
+                    { "--accumulators", to_string( payload.accumulators() ) } );
+  }
+
+  for ( const auto& server : payload.memcached_servers() ) {
+    command.insert( command.end(), { "--memcached-server", server } );
+  }
+
+  if ( not payload.scene_hash().empty() ) {
+    command.insert( command.end(), { "--scene-hash", payload.scene_hash() } );
+  }
+
+  if ( payload.invoked_at() ) {
+    command.insert( command.end(),
+                    { "--invoked-at", to_string( payload.invoked_at() ) } );
+  }
+
+  return command;
+}
+
+string scene_hash( const map<string, string>& base_objects )
+{
+  string input;
+
+  for ( const auto& [name, contents] : base_objects ) {
+    input += name;
+    input += '\0';
+    input += to_string( contents.length() );
+    input += '\0';
+    input += contents;
+  }
+
+  return digest::sha256_base58( input );
+}
+
+}
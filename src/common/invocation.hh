@@ -0,0 +1,22 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "r2t2.pb.h"
+
+namespace r2t2 {
+
+/* the r2t2-lambda-worker command line for an invocation payload; mirrors
+   what the Lambda handler (remote/lambda-function/main.py) runs */
+std::vector<std::string> worker_command(
+  const protobuf::InvocationPayload& payload,
+  const std::string& program = "r2t2-lambda-worker" );
+
+/* identifies a scene by its base objects (name -> contents); warm workers
+   use it to tell whether what they preloaded belongs to an invocation */
+std::string scene_hash(
+  const std::map<std::string, std::string>& base_objects );
+
+}
@@ -1,24 +1,36 @@
 #pragma once
 
+#include <charconv>
 #include <chrono>
 #include <cstdint>
+#include <optional>
 #include <random>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <pbrt/main.h>
 
 #include "util/uri.hh"
 
 constexpr std::chrono::milliseconds DEFAULT_BAGGING_DELAY { 50 };
-constexpr size_t WORKER_MAX_ACTIVE_RAYS = 100'000;       /* ~120 MiB of rays */
-constexpr size_t WORKER_MAX_ACTIVE_SAMPLES = 10'000'000; /* 320 MB of samples */
+constexpr size_t WORKER_MAX_ACTIVE_RAYS = 100'000; /* ~120 MiB of rays */
 
 using WorkerId = uint64_t;
 using TreeletId = uint32_t;
 using BagId = uint64_t;
 using TileId = TreeletId;
 
+/* scene objects that every worker loads, whatever its treelets */
+inline const std::vector<pbrt::ObjectType> BASE_OBJECT_TYPES {
+  pbrt::ObjectType::Manifest,   pbrt::ObjectType::Scene,
+  pbrt::ObjectType::Camera,     pbrt::ObjectType::Lights,
+  pbrt::ObjectType::AreaLights, pbrt::ObjectType::Sampler
+};
+
+/* written by compress-scene next to the objects it compresses */
+constexpr char COMPRESSION_MANIFEST_NAME[] = "COMPRESSION";
+
 struct Storage
 {
   std::string region {};
@@ -38,6 +50,7 @@ struct SceneObject
 {
   pbrt::ObjectKey key;
   std::string alt_name {};
+  bool compressed { false };
 
   SceneObject( const pbrt::ObjectKey& key_ )
     : key( key_ )
@@ -77,18 +90,25 @@ struct RayBagInfo
   size_t bag_size {};
   bool sample_bag { false };
 
+  /* the treelet the rays were traced in, when they all come from one */
+  std::optional<TreeletId> source_treelet_id {};
+
+  /* the bag's key in storage; called for every bag a worker moves, so it
+     doesn't go through a stream */
   std::string str( const std::string& prefix ) const
   {
-    std::ostringstream oss;
-
-    if ( !sample_bag ) {
-      oss << prefix << "T" << treelet_id << "/W" << worker_id << "/B" << bag_id;
-    } else {
-      oss << prefix << "samples/T" << tile_id << "/W" << worker_id << "/B"
-          << bag_id;
-    }
-
-    return oss.str();
+    std::string key;
+    key.reserve( prefix.length() + 64 );
+
+    key += prefix;
+    key += sample_bag ? "samples/T" : "T";
+    append_number( key, sample_bag ? tile_id : treelet_id );
+    key += "/W";
+    append_number( key, worker_id );
+    key += "/B";
+    append_number( key, bag_id );
+
+    return key;
   }
 
   RayBagInfo( const WorkerId worker_id_,
@@ -123,14 +143,25 @@ struct RayBagInfo
     static RayBagInfo bag;
     return bag;
   }
+
+private:
+  static void append_number( std::string& out, const uint64_t value )
+  {
+    char buffer[20];
+    out.append( buffer,
+                std::to_chars( buffer, buffer + sizeof( buffer ), value ).ptr );
+  }
 };
 
 struct RayBag
 {
+  /* for a received bag, when it was dequeued */
   std::chrono::steady_clock::time_point created_at {
     std::chrono::steady_clock::now()
   };
 
+  std::chrono::steady_clock::time_point sealed_at {};
+
   RayBagInfo info;
   std::string data;
 
@@ -49,4 +49,73 @@ WorkerStats WorkerStats::operator-( const WorkerStats& other ) const
   return res;
 }
 
+void TransitionMatrix::add( const TreeletId src,
+                            const TreeletId dst,
+                            const double bytes )
+{
+  weights_[key( src, dst )] += bytes;
+}
+
+void TransitionMatrix::decay( const double factor )
+{
+  /* less than a byte is as good as nothing */
+  constexpr double MIN_WEIGHT = 1.0;
+
+  for ( auto it = weights_.begin(); it != weights_.end(); ) {
+    it->second *= factor;
+
+    if ( it->second < MIN_WEIGHT ) {
+      it = weights_.erase( it );
+    } else {
+      it++;
+    }
+  }
+}
+
+double TransitionMatrix::weight( const TreeletId src,
+                                 const TreeletId dst ) const
+{
+  const auto it = weights_.find( key( src, dst ) );
+  return ( it == weights_.end() ) ? 0.0 : it->second;
+}
+
+double TransitionMatrix::total() const
+{
+  double result = 0;
+
+  for ( const auto& [k, w] : weights_ ) {
+    result += w;
+  }
+
+  return result;
+}
+
+vector<TransitionMatrix::Entry> TransitionMatrix::entries() const
+{
+  vector<Entry> result;
+  result.reserve( weights_.size() );
+
+  for ( const auto& [k, w] : weights_ ) {
+    result.emplace_back(
+      static_cast<TreeletId>( k >> 32 ), static_cast<TreeletId>( k ), w );
+  }
+
+  return result;
+}
+
+const char* stage_name( const BagStage stage )
+{
+  // clang-format off
+  switch ( stage ) {
+    case BagStage::Open: return "open";
+    case BagStage::Submit: return "submit";
+    case BagStage::Upload: return "upload";
+    case BagStage::Download: return "download";
+    case BagStage::Unpack: return "unpack";
+  }
+  // clang-format on
+
+  return "unknown";
+}
+
 } // namespace r2t2
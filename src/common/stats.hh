@@ -1,11 +1,14 @@
 #pragma once
 
+#include <array>
 #include <cmath>
 #include <cstdint>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 
 #include "lambda.hh"
+#include "util/histogram.hh"
 
 namespace r2t2 {
 
@@ -47,4 +50,55 @@ struct WorkerStats
   WorkerStats operator-( const WorkerStats& other ) const;
 };
 
+/* bytes of rays sent from one treelet to another, decayed over time. Only
+   the pairs that have seen any traffic are kept. */
+class TransitionMatrix
+{
+public:
+  using Entry = std::tuple<TreeletId, TreeletId, double>;
+
+private:
+  std::unordered_map<uint64_t, double> weights_ {};
+
+  static uint64_t key( const TreeletId src, const TreeletId dst )
+  {
+    return ( static_cast<uint64_t>( src ) << 32 ) | dst;
+  }
+
+public:
+  void add( const TreeletId src, const TreeletId dst, const double bytes );
+
+  /* scales every weight by `factor`, forgetting the ones that fade out */
+  void decay( const double factor );
+
+  double weight( const TreeletId src, const TreeletId dst ) const;
+
+  /* traffic in both directions between the two treelets */
+  double affinity( const TreeletId a, const TreeletId b ) const
+  {
+    return weight( a, b ) + weight( b, a );
+  }
+
+  double total() const;
+  std::vector<Entry> entries() const;
+  bool empty() const { return weights_.empty(); }
+};
+
+/* the legs of a ray bag's trip that workers can time on their own */
+enum class BagStage
+{
+  Open,     /* Created -> Sealed */
+  Submit,   /* Sealed -> Submitted */
+  Upload,   /* Submitted -> Enqueued */
+  Download, /* Requested -> Dequeued */
+  Unpack,   /* Dequeued -> Opened */
+};
+
+constexpr size_t BAG_STAGE_COUNT = 5;
+
+/* in microseconds */
+using BagLatencies = std::array<Histogram, BAG_STAGE_COUNT>;
+
+const char* stage_name( const BagStage stage );
+
 } // namespace r2t2
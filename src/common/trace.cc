@@ -0,0 +1,137 @@
+#include "trace.hh"
+
+using namespace std;
+using namespace r2t2;
+
+const char* r2t2::action_name( const RayAction action )
+{
+  // clang-format off
+  switch ( action ) {
+    case RayAction::Generated: return "Generated";
+    case RayAction::Traced: return "Traced";
+    case RayAction::Queued: return "Queued";
+    case RayAction::Bagged: return "Bagged";
+    case RayAction::Unbagged: return "Unbagged";
+    case RayAction::Finished: return "Finished";
+  }
+  // clang-format on
+
+  return "Unknown";
+}
+
+const char* r2t2::action_name( const BagAction action )
+{
+  // clang-format off
+  switch ( action ) {
+    case BagAction::Created: return "Created";
+    case BagAction::Sealed: return "Sealed";
+    case BagAction::Submitted: return "Submitted";
+    case BagAction::Enqueued: return "Enqueued";
+    case BagAction::Requested: return "Requested";
+    case BagAction::Dequeued: return "Dequeued";
+    case BagAction::Opened: return "Opened";
+  }
+  // clang-format on
+
+  return "Unknown";
+}
+
+void TraceRecord::set_bag( const RayBagInfo& info )
+{
+  bag_id = info.bag_id;
+  bag_worker_id = static_cast<uint32_t>( info.worker_id );
+  bag_treelet_id = info.treelet_id;
+  ray_count = static_cast<uint32_t>( info.ray_count );
+  bag_size = static_cast<uint32_t>( info.bag_size );
+  flags |= HAS_BAG | ( info.sample_bag ? SAMPLE_BAG : 0 );
+}
+
+RayBagInfo TraceRecord::bag() const
+{
+  return RayBagInfo { bag_worker_id,
+                      bag_treelet_id,
+                      bag_id,
+                      ray_count,
+                      bag_size,
+                      ( flags & SAMPLE_BAG ) != 0 };
+}
+
+atomic<uint64_t> TraceRecorder::next_id_ { 0 };
+
+TraceRecorder::Ring& TraceRecorder::local_ring()
+{
+  /* the rings this thread has, by recorder; they're given back when the
+     thread exits, and shared so that they outlive either side */
+  thread_local struct LocalRings
+  {
+    vector<pair<uint64_t, shared_ptr<Ring>>> rings {};
+
+    ~LocalRings()
+    {
+      for ( auto& [id, ring] : rings ) {
+        ring->in_use.store( false, memory_order_release );
+      }
+    }
+  } local;
+
+  for ( const auto& [id, ring] : local.rings ) {
+    if ( id == id_ ) {
+      return *ring;
+    }
+  }
+
+  /* a thread takes a ring the first time it records something: one that
+     a thread before it gave back, or else a new one */
+  lock_guard<mutex> lock { rings_mutex_ };
+  shared_ptr<Ring> ring;
+
+  for ( const auto& candidate : rings_ ) {
+    if ( not candidate->in_use.load( memory_order_acquire ) ) {
+      candidate->in_use.store( true, memory_order_relaxed );
+      ring = candidate;
+      break;
+    }
+  }
+
+  if ( not ring ) {
+    ring = rings_.emplace_back( make_shared<Ring>() );
+  }
+
+  local.rings.emplace_back( id_, ring );
+  return *ring;
+}
+
+void TraceRecorder::record( const TraceRecord& record )
+{
+  Ring& ring = local_ring();
+  const uint64_t head = ring.head.load( memory_order_relaxed );
+
+  if ( head - ring.tail.load( memory_order_acquire ) == RING_SIZE ) {
+    dropped_.fetch_add( 1, memory_order_relaxed );
+    return;
+  }
+
+  ring.records[head % RING_SIZE] = record;
+  ring.head.store( head + 1, memory_order_release );
+}
+
+size_t TraceRecorder::drain( string& out )
+{
+  lock_guard<mutex> lock { rings_mutex_ };
+  size_t count = 0;
+
+  for ( auto& ring : rings_ ) {
+    const uint64_t head = ring->head.load( memory_order_acquire );
+    const uint64_t tail = ring->tail.load( memory_order_relaxed );
+
+    for ( uint64_t i = tail; i < head; i++ ) {
+      const TraceRecord& record = ring->records[i % RING_SIZE];
+      out.append( reinterpret_cast<const char*>( &record ), sizeof( record ) );
+    }
+
+    ring->tail.store( head, memory_order_release );
+    count += head - tail;
+  }
+
+  return count;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lambda.hh"
+
+namespace r2t2 {
+
+enum class RayAction : uint8_t
+{
+  Generated,
+  Traced,
+  Queued,
+  Bagged,
+  Unbagged,
+  Finished
+};
+
+enum class BagAction : uint8_t
+{
+  Created,
+  Sealed,
+  Submitted,
+  Enqueued,
+  Requested,
+  Dequeued,
+  Opened
+};
+
+const char* action_name( const RayAction action );
+const char* action_name( const BagAction action );
+
+/* One sampled ray or bag event on a worker (--log-rays, --log-bags). The
+   records have a fixed size and are written out as they are in memory: a
+   trace chunk is a TraceHeader followed by an array of these. */
+struct TraceRecord
+{
+  enum class Kind : uint8_t
+  {
+    Ray,
+    Bag
+  };
+
+  static constexpr uint8_t SHADOW_RAY = 1;
+  static constexpr uint8_t SAMPLE_BAG = 2;
+  static constexpr uint8_t HAS_BAG = 4;
+
+  uint64_t timestamp {}; /* microseconds since the epoch */
+  uint64_t path_id {};
+  uint64_t bag_id {};
+  uint32_t bag_worker_id {};
+  uint32_t bag_treelet_id {};
+  uint32_t treelet_id {}; /* the treelet a ray is in */
+  uint32_t ray_count {};
+  uint32_t bag_size {};
+  uint16_t hop {};
+  Kind kind {};
+  uint8_t action {};
+  uint8_t remaining_bounces {};
+  uint8_t flags {};
+  uint8_t padding[2] {};
+
+  void set_bag( const RayBagInfo& info );
+  RayBagInfo bag() const;
+};
+
+static_assert( sizeof( TraceRecord ) == 56, "trace chunks are read as is" );
+
+struct TraceHeader
+{
+  static constexpr std::string_view MAGIC = "R2T2TRC1";
+
+  char magic[8] {};
+  uint64_t worker_id {};
+  uint64_t dropped_records {}; /* by this worker, up to this chunk */
+
+  /* A worker uploads <id>-0.trace, <id>-1.trace, ... as it goes, and
+     <id>.trace when it's done; that last one says how many came before. */
+  uint64_t earlier_chunks {};
+};
+
+/* Collects trace records from any number of threads. Each thread appends
+   to a ring of its own without taking a lock, and the event loop drains
+   them all every now and then. When a ring is full, the record is dropped
+   and counted, so tracing never holds up the thread it's tracing. A ring
+   is handed to another thread once the one it belonged to exits. */
+class TraceRecorder
+{
+public:
+  static constexpr size_t RING_SIZE = 16384;
+
+private:
+  struct Ring
+  {
+    std::array<TraceRecord, RING_SIZE> records {};
+    alignas( 64 ) std::atomic<uint64_t> head { 0 };
+    alignas( 64 ) std::atomic<uint64_t> tail { 0 };
+    std::atomic<bool> in_use { true }; /* by a thread that's still around */
+  };
+
+  /* tells recorders apart in the threads' lists of rings, even when one
+     takes the place of another at the same address */
+  static std::atomic<uint64_t> next_id_;
+  const uint64_t id_ { next_id_++ };
+
+  std::mutex rings_mutex_ {};
+  std::vector<std::shared_ptr<Ring>> rings_ {};
+  std::atomic<uint64_t> dropped_ { 0 };
+
+  Ring& local_ring();
+
+public:
+  void record( const TraceRecord& record );
+
+  /* appends the records in every ring to `out` and returns their count */
+  size_t drain( std::string& out );
+
+  uint64_t dropped() const { return dropped_.load(); }
+};
+
+} // namespace r2t2
@@ -0,0 +1,79 @@
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "common/lambda.hh"
+#include "messages/utils.hh"
+#include "r2t2.pb.h"
+#include "storage/backend_local.hh"
+#include "util/exception.hh"
+#include "util/lz4_frame.hh"
+#include "util/util.hh"
+
+using namespace std;
+using namespace r2t2;
+
+void usage( char* argv0 )
+{
+  cerr << "Usage: " << argv0 << " SCENE-DIR" << endl;
+}
+
+int main( int argc, char* argv[] )
+{
+  if ( argc <= 0 ) {
+    abort();
+  }
+
+  if ( argc != 2 ) {
+    usage( argv[0] );
+    return EXIT_FAILURE;
+  }
+
+  try {
+    const filesystem::path scene_dir { argv[1] };
+    protobuf::CompressionManifest manifest;
+
+    uint64_t total_size = 0;
+    uint64_t total_compressed_size = 0;
+
+    for ( const auto& entry : filesystem::directory_iterator( scene_dir ) ) {
+      const string name = entry.path().filename().string();
+
+      /* the uncompressed objects stay, for the master and file:// workers */
+      if ( not entry.is_regular_file() or entry.path().has_extension()
+           or name == COMPRESSION_MANIFEST_NAME ) {
+        continue;
+      }
+
+      const string data = LocalStorageBackend::read_object( entry.path() );
+      const string compressed = lz4_frame::compress( data );
+
+      if ( compressed.length() >= data.length() ) {
+        continue;
+      }
+
+      LocalStorageBackend::write_object(
+        compressed, scene_dir / ( name + string { lz4_frame::SUFFIX } ) );
+
+      auto& obj = *manifest.add_objects();
+      obj.set_name( name );
+      obj.set_size( data.length() );
+      obj.set_compressed_size( compressed.length() );
+
+      total_size += data.length();
+      total_compressed_size += compressed.length();
+    }
+
+    LocalStorageBackend::write_object( protoutil::to_json( manifest ),
+                                       scene_dir / COMPRESSION_MANIFEST_NAME );
+
+    cerr << "Compressed " << pluralize( "object", manifest.objects_size() )
+         << ", " << format_bytes( total_size ) << " \u2192 "
+         << format_bytes( total_compressed_size ) << "." << endl;
+  } catch ( const exception& ex ) {
+    print_exception( argv[0], ex );
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
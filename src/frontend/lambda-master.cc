@@ -20,6 +20,8 @@
 #include <thread>
 #include <vector>
 
+#include "common/invocation.hh"
+#include "common/trace.hh"
 #include "messages/message.hh"
 #include "messages/utils.hh"
 #include "net/lambda.hh"
@@ -28,13 +30,16 @@
 #include "net/transfer_mcd.hh"
 #include "net/util.hh"
 #include "schedulers/adaptive.hh"
+#include "schedulers/colocation.hh"
 #include "schedulers/dynamic.hh"
 #include "schedulers/null.hh"
+#include "schedulers/queueing.hh"
 #include "schedulers/rootonly.hh"
 #include "schedulers/static.hh"
 #include "schedulers/uniform.hh"
 #include "util/digest.hh"
 #include "util/exception.hh"
+#include "util/fileutils.hh"
 #include "util/random.hh"
 #include "util/status_bar.hh"
 #include "util/temp_file.hh"
@@ -81,13 +86,10 @@ LambdaMaster::LambdaMaster( const uint16_t listen_port,
   , public_address( public_address_ )
   , storage_backend_uri( storage_backend_uri_ )
   , storage_backend_info( storage_backend_uri )
-  , scene_storage_backend( aws_credentials,
-                           storage_backend_info.bucket,
-                           storage_backend_info.region,
-                           storage_backend_info.path )
-  , job_storage_backend( aws_credentials,
-                         storage_backend_info.bucket,
-                         storage_backend_info.region )
+  , scene_storage_backend(
+      StorageBackend::create_backend( storage_backend_uri ) )
+  , job_storage_backend(
+      StorageBackend::create_backend( storage_backend_uri, true ) )
   , aws_region( aws_region_ )
   , aws_address( LambdaInvocationRequest::endpoint( aws_region ), "https" )
   , max_workers( max_workers_ )
@@ -102,6 +104,10 @@ LambdaMaster::LambdaMaster( const uint16_t listen_port,
                              loop.add_category( "HTTPResponse read" ),
                              loop.add_category( "HTTPRequest write" ),
                              loop.add_category( "Process HTTPResponse" ) } )
+  , engine_rule_categories( { loop.add_category( "Engine" ),
+                              loop.add_category( "Engine response read" ),
+                              loop.add_category( "Engine request write" ),
+                              loop.add_category( "Process engine response" ) } )
 {
   signals.set_as_mask();
 
@@ -152,7 +158,7 @@ LambdaMaster::LambdaMaster( const uint16_t listen_port,
       }
 
       cout << ")... ";
-      scene_storage_backend.put( upload_requests );
+      scene_storage_backend->put( upload_requests );
       cout << "done." << endl;
     }
   }
@@ -173,12 +179,13 @@ LambdaMaster::LambdaMaster( const uint16_t listen_port,
 
   if ( not scene_obj_reqs.empty() ) {
     cout << "\u2198 Downloading scene data... ";
-    scene_storage_backend.get( scene_obj_reqs );
+    scene_storage_backend->get( scene_obj_reqs );
     cout << "done." << endl;
   }
 
   /* now we can initialize the scene */
   scene = { scene_path, config.samples_per_pixel, config.crop_window };
+  load_compression_manifest( scene_path );
 
   /* initializing tile helper used for *accumulation* */
   tile_helper = { static_cast<uint32_t>( accumulators ),
@@ -209,7 +216,25 @@ LambdaMaster::LambdaMaster( const uint16_t listen_port,
     *invocation_proto.add_memcached_servers() = server;
   }
 
+  /* lets warm workers that preloaded this scene skip its base objects */
+  if ( alternative_object_names.empty() ) {
+    map<string, string> base_objects;
+
+    for ( const auto scene_obj : SceneData::base_object_types ) {
+      const auto name = scene::GetObjectName( scene_obj, 0 );
+      base_objects.emplace(
+        name, roost::read_file( filesystem::path( scene_path ) / name ) );
+    }
+
+    invocation_proto.set_scene_hash( scene_hash( base_objects ) );
+  }
+
   invocation_payload = protoutil::to_json( invocation_proto );
+  setup_engines( invocation_proto );
+
+  /* connections are opened as invocations need them */
+  lambda_connections.resize( config.lambda_connections );
+  invocation_window = lambda_connections.size() * INVOCATION_PIPELINE_DEPTH;
 
   /* initializing the treelets array */
   treelet_count = scene.base.GetTreeletCount();
@@ -224,6 +249,7 @@ LambdaMaster::LambdaMaster( const uint16_t listen_port,
 
   queued_ray_bags.resize( treelet_count + tile_helper.active_accumulators() );
   pending_ray_bags.resize( treelet_count + tile_helper.active_accumulators() );
+  ready_workers.resize( treelet_count );
 
   if ( config.auto_name_log_dir_tag ) {
     // setting the directory name based on job info
@@ -246,24 +272,73 @@ LambdaMaster::LambdaMaster( const uint16_t listen_port,
   }
 
   if ( config.write_stat_logs ) {
-    ws_stream.open( config.logs_directory / "workers.csv", ios::trunc );
-    tl_stream.open( config.logs_directory / "treelets.csv", ios::trunc );
-    alloc_stream.open( config.logs_directory / "allocations.csv", ios::trunc );
-    summary_stream.open( config.logs_directory / "summary.csv", ios::trunc );
-
-    ws_stream << "timestamp,workerId,pathsFinished,"
-                 "raysEnqueued,raysAssigned,raysDequeued,"
-                 "bytesEnqueued,bytesAssigned,bytesDequeued,"
-                 "bagsEnqueued,bagsAssigned,bagsDequeued,"
-                 "numSamples,bytesSamples,bagsSamples,cpuUsage\n";
+    using column_log::Type;
 
-    tl_stream << "timestamp,treeletId,raysEnqueued,raysDequeued,"
-                 "bytesEnqueued,bytesDequeued,bagsEnqueued,bagsDequeued,"
-                 "enqueueRate,dequeueRate,cpuUsage\n";
+    auto columns = []( const Type type, initializer_list<string> names ) {
+      vector<column_log::Column> result;
+      for ( const auto& name : names ) {
+        result.push_back( { name, type } );
+      }
+      return result;
+    };
 
-    alloc_stream << "workerId,treeletId,action\n";
+    auto concat = []( vector<column_log::Column> a,
+                      const vector<column_log::Column>& b ) {
+      a.insert( a.end(), b.begin(), b.end() );
+      return a;
+    };
 
-    summary_stream << "workerId,treeletId,trace,shade,nodes,visited\n";
+    const auto& dir = config.logs_directory;
+
+    ws_log.open( dir / "workers.cols",
+                 concat( columns( Type::Int,
+                                  { "timestamp",
+                                    "workerId",
+                                    "pathsFinished",
+                                    "raysEnqueued",
+                                    "raysAssigned",
+                                    "raysDequeued",
+                                    "bytesEnqueued",
+                                    "bytesAssigned",
+                                    "bytesDequeued",
+                                    "bagsEnqueued",
+                                    "bagsAssigned",
+                                    "bagsDequeued",
+                                    "numSamples",
+                                    "bytesSamples",
+                                    "bagsSamples" } ),
+                         columns( Type::Double, { "cpuUsage" } ) ) );
+
+    tl_log.open( dir / "treelets.cols",
+                 concat( columns( Type::Int,
+                                  { "timestamp",
+                                    "treeletId",
+                                    "raysEnqueued",
+                                    "raysDequeued",
+                                    "bytesEnqueued",
+                                    "bytesDequeued",
+                                    "bagsEnqueued",
+                                    "bagsDequeued" } ),
+                         columns( Type::Double,
+                                  { "enqueueRate",
+                                    "dequeueRate",
+                                    "cpuUsage" } ) ) );
+
+    alloc_log.open( dir / "allocations.cols",
+                    concat( columns( Type::Int, { "workerId", "treeletId" } ),
+                            columns( Type::String, { "action" } ) ) );
+
+    tr_log.open(
+      dir / "transitions.cols",
+      concat(
+        columns( Type::Int, { "timestamp", "srcTreeletId", "dstTreeletId" } ),
+        columns( Type::Double, { "weight" } ) ) );
+
+    summary_log.open(
+      dir / "summary.cols",
+      columns(
+        Type::Int,
+        { "workerId", "treeletId", "trace", "shade", "nodes", "visited" } ) );
   }
 
   auto print_info = []( const string& key, auto value ) {
@@ -348,11 +423,30 @@ LambdaMaster::LambdaMaster( const uint16_t listen_port,
                  worker_invocation_timer,
                  bind( &LambdaMaster::handle_worker_invocation, this ),
                  [this] {
-                   return !treelets_to_spawn.empty()
-                          && ( Worker::active_count[Worker::Role::Tracer]
-                               < this->max_workers );
+                   return pending_invocations > 0
+                          || ( !treelets_to_spawn.empty()
+                               && ( Worker::active_count[Worker::Role::Tracer]
+                                    < target_workers ) );
                  } );
 
+  if ( config.deadline or config.cost_budget ) {
+    loop.add_rule( "Autoscale",
+                   Direction::In,
+                   autoscale_timer,
+                   bind( &LambdaMaster::handle_autoscale, this ),
+                   [] { return true; } );
+  }
+
+  if ( config.message_shards ) {
+    message_shards = make_unique<MessageShards>( config.message_shards );
+
+    loop.add_rule( "Decoded messages",
+                   Direction::In,
+                   message_shards->decoded_fd(),
+                   bind( &LambdaMaster::handle_decoded_messages, this ),
+                   [] { return true; } );
+  }
+
   loop.add_rule( "Status",
                  Direction::In,
                  status_print_timer,
@@ -378,39 +472,11 @@ LambdaMaster::LambdaMaster( const uint16_t listen_port,
         return;
       }
 
-      const WorkerId worker_id = Worker::next_id++;
-
-      auto connection_close_handler = [this, worker_id] {
-        auto& worker = workers[worker_id];
-        worker.client.uninstall_rules();
-
-        if ( worker.state == Worker::State::Terminating ) {
-          if ( worker.role == Worker::Role::Generator ) {
-            last_generator_done = steady_clock::now();
-            finished_ray_generators++;
-          }
-
-          /* it's okay for this worker to go away,
-             let's not panic! */
-          worker.state = Worker::State::Terminated;
-          Worker::active_count[worker.role]--;
-
-          if ( !worker.outstanding_ray_bags.empty() ) {
-            throw runtime_error( "worker died without finishing its work: "
-                                 + to_string( worker_id ) );
-          }
-
-          return;
-        }
-
-        cerr << "Worker info: " << worker.to_string() << endl;
+      if ( not starting_workers.empty() ) {
+        starting_workers.pop_front();
+      }
 
-        throw runtime_error(
-          "worker died unexpectedly: " + to_string( worker_id )
-          + ( worker.aws_log_stream.empty()
-                ? ""s
-                : ( " ("s + worker.aws_log_stream + ")"s ) ) );
-      };
+      const WorkerId worker_id = Worker::next_id++;
 
       if ( worker_id < this->ray_generators ) {
         /* This worker is a ray generator
@@ -484,21 +550,23 @@ LambdaMaster::LambdaMaster( const uint16_t listen_port,
       } else {
         /* this is a normal worker */
         if ( !treelets_to_spawn.empty() ) {
-          const TreeletId treelet_id = treelets_to_spawn.front();
+          const auto group = move( treelets_to_spawn.front() );
           treelets_to_spawn.pop_front();
 
-          auto& treelet = treelets[treelet_id];
-          treelet.pending_workers--;
-
           /* (0) create the entry for the worker */
           auto& worker = workers.emplace_back(
             worker_id, Worker::Role::Tracer, move( socket ) );
 
           assign_base_objects( worker );
-          assign_treelet( worker, treelet );
 
-          if ( config.write_stat_logs ) {
-            alloc_stream << worker_id << ',' << treelet_id << ",add\n";
+          for ( const TreeletId treelet_id : group ) {
+            auto& treelet = treelets[treelet_id];
+            treelet.pending_workers--;
+            assign_treelet( worker, treelet );
+
+            if ( config.write_stat_logs ) {
+              alloc_log.append( worker_id, treelet_id, "add" );
+            }
           }
 
           /* (1) saying hi, assigning id to the worker */
@@ -527,9 +595,25 @@ LambdaMaster::LambdaMaster( const uint16_t listen_port,
         loop,
         worker_rule_categories,
         [worker_id, this]( Message&& msg ) {
-          process_message( worker_id, move( msg ) );
+          if ( message_shards ) {
+            message_shards->push( worker_id, move( msg ) );
+          } else {
+            inline_message.worker_id = worker_id;
+            inline_message.message.emplace( move( msg ) );
+            decode_message( inline_message );
+            process_message( inline_message );
+          }
         },
-        connection_close_handler );
+        [worker_id, this] {
+          workers[worker_id].client.uninstall_rules();
+
+          /* after the messages that are still being decoded */
+          if ( message_shards ) {
+            message_shards->push_close( worker_id );
+          } else {
+            handle_worker_close( worker_id );
+          }
+        } );
     },
     [] { return true; },
     [] { throw runtime_error( "listener socket closed" ); } );
@@ -539,14 +623,53 @@ LambdaMaster::LambdaMaster( const uint16_t listen_port,
   }
 }
 
+void LambdaMaster::handle_worker_close( const WorkerId worker_id )
+{
+  auto& worker = workers[worker_id];
+
+  if ( worker.state == Worker::State::Terminating ) {
+    if ( worker.role == Worker::Role::Generator ) {
+      last_generator_done = steady_clock::now();
+      finished_ray_generators++;
+    }
+
+    /* it's okay for this worker to go away,
+       let's not panic! */
+    worker.state = Worker::State::Terminated;
+    Worker::active_count[worker.role]--;
+
+    if ( not worker.outstanding_ray_bags.empty() ) {
+      throw runtime_error( "worker died without finishing its work: "
+                           + to_string( worker_id ) );
+    }
+
+    return;
+  }
+
+  cerr << "Worker info: " << worker.to_string() << endl;
+
+  /* the rays a tracer holds are lost with it, so only an idle one can be
+     replaced without losing work */
+  if ( worker.role == Worker::Role::Tracer
+       and worker.state == Worker::State::Active and worker.active_rays() == 0
+       and worker.outstanding_ray_bags.empty() ) {
+    cerr << "Worker " << worker_id << " died while idle; replacing it."
+         << endl;
+
+    recover_worker( worker );
+    return;
+  }
+
+  throw runtime_error( "worker died unexpectedly: " + to_string( worker_id )
+                       + ( worker.aws_log_stream.empty()
+                             ? ""s
+                             : ( " ("s + worker.aws_log_stream + ")"s ) ) );
+}
+
 string LambdaMaster::Worker::to_string() const
 {
   ostringstream oss;
 
-  size_t oustanding_size = 0;
-  for ( const auto& bag : outstanding_ray_bags )
-    oustanding_size += bag.bag_size;
-
   oss << "id=" << id << ",state=" << static_cast<int>( state )
       << ",role=" << static_cast<int>( role ) << ",awslog=" << aws_log_stream
       << ",treelets=";
@@ -558,7 +681,7 @@ string LambdaMaster::Worker::to_string() const
   }
 
   oss << ",outstanding-bags=" << outstanding_ray_bags.size()
-      << ",outstanding-bytes=" << oustanding_size
+      << ",outstanding-bytes=" << outstanding_bytes
       << ",rays={.camera:" << rays.camera << ",.generated:" << rays.generated
       << ",.dequeued:" << rays.dequeued << ",.terminated:" << rays.terminated
       << ",.enqueued:" << rays.enqueued << "},active-rays=" << active_rays()
@@ -640,13 +763,12 @@ void LambdaMaster::run()
 
   while ( state_ != State::Terminated
           && loop.wait_next_event( -1 ) != EventLoop::Result::Exit ) {
-    // cleaning up finished http clients
-    if ( not finished_https_clients.empty() ) {
-      for ( auto& it : finished_https_clients ) {
-        https_clients.erase( it );
+    if ( not finished_engine_clients.empty() ) {
+      for ( auto& it : finished_engine_clients ) {
+        engine_clients.erase( it );
       }
 
-      finished_https_clients.clear();
+      finished_engine_clients.clear();
     }
 
     /* XXX What's happening here? */
@@ -660,10 +782,11 @@ void LambdaMaster::run()
   vector<storage::GetRequest> get_requests;
   const string log_prefix = "jobs/" + job_id + "/logs/";
 
-  ws_stream.close();
-  tl_stream.close();
-  alloc_stream.close();
-  summary_stream.close();
+  ws_log.close();
+  tl_log.close();
+  alloc_log.close();
+  tr_log.close();
+  summary_log.close();
 
   for ( auto& worker : workers ) {
     if ( worker.state != Worker::State::Terminated ) {
@@ -677,6 +800,12 @@ void LambdaMaster::run()
                                  config.logs_directory
                                    / ( to_string( worker.id ) + ".INFO" ) );
     }
+
+    if ( config.ray_log_rate || config.bag_log_rate ) {
+      get_requests.emplace_back( log_prefix + to_string( worker.id ) + ".trace",
+                                 config.logs_directory
+                                   / ( to_string( worker.id ) + ".trace" ) );
+    }
   }
 
   cout << endl;
@@ -697,13 +826,50 @@ void LambdaMaster::run()
     cout << "\n\u2198 Downloading " << get_requests.size() << " log file(s)... "
          << flush;
     this_thread::sleep_for( 10s );
-    job_storage_backend.get( get_requests );
+    job_storage_backend->get( get_requests );
     cout << "done." << endl;
   }
 
+  if ( config.ray_log_rate || config.bag_log_rate ) {
+    download_trace_chunks();
+  }
+
   cout << endl;
 }
 
+void LambdaMaster::download_trace_chunks()
+{
+  /* each worker's last chunk says how many it had uploaded before it */
+  vector<storage::GetRequest> get_requests;
+  const string log_prefix = "jobs/" + job_id + "/logs/";
+
+  for ( auto& worker : workers ) {
+    const auto last_path
+      = config.logs_directory / ( to_string( worker.id ) + ".trace" );
+
+    TraceHeader header;
+    ifstream fin { last_path, ios::binary };
+
+    if ( not fin.read( reinterpret_cast<char*>( &header ),
+                       sizeof( header ) ) ) {
+      continue;
+    }
+
+    for ( uint64_t i = 0; i < header.earlier_chunks; i++ ) {
+      const string name = to_string( worker.id ) + "-" + to_string( i );
+      get_requests.emplace_back( log_prefix + name + ".trace",
+                                 config.logs_directory / ( name + ".trace" ) );
+    }
+  }
+
+  if ( !get_requests.empty() ) {
+    cout << "\u2198 Downloading " << get_requests.size()
+         << " trace chunk(s)... " << flush;
+    job_storage_backend->get( get_requests );
+    cout << "done." << endl;
+  }
+}
+
 void LambdaMaster::handle_signal( const signalfd_siginfo& sig )
 {
   switch ( sig.ssi_signo ) {
@@ -717,6 +883,10 @@ void LambdaMaster::handle_signal( const signalfd_siginfo& sig )
       terminate( "Interrupted by signal." );
       break;
 
+    case SIGCHLD:
+      handle_local_worker_exits();
+      break;
+
     default:
       throw runtime_error( "unhandled signal" );
   }
@@ -810,6 +980,8 @@ void usage( const char* argv0, int exit_code )
        << "  -a --scheduler TYPE        indicate scheduler type:" << endl
        << "                               - uniform (default)" << endl
        << "                               - static" << endl
+       << "                               - queueing" << endl
+       << "                               - colocation" << endl
        << "                               - all" << endl
        << "                               - none" << endl
        << "  -F --scheduler-file FILE   set the allocation file" << endl
@@ -826,6 +998,38 @@ void usage( const char* argv0, int exit_code )
        << endl
        << "  -d --memcached-server      address for memcached" << endl
        << "                             (can be repeated)" << endl
+       << "  -J --jobs N                max workers on the engines that follow"
+       << endl
+       << "  -E --engine ENGINE         launch workers on ENGINE instead of"
+       << endl
+       << "                             Lambda (can be repeated):" << endl
+       << "                               - local: fork workers here" << endl
+       << "                               - HOST:PORT: a r2t2-lambda-server"
+       << endl
+       << "  -Y --deadline T            resize the pool to finish within T"
+       << endl
+       << "                             seconds" << endl
+       << "  -U --budget DOLLARS        resize the pool to stay within budget"
+       << endl
+       << "  -K --worker-cost DOLLARS   cost of a worker per second" << endl
+       << "  -W --worker-memory MIB     memory of a worker, if it doesn't"
+       << endl
+       << "                             report it (default: 3008)" << endl
+       << "  -R --tracer-share F        share of a tracer's memory for queued"
+       << endl
+       << "                             rays (default: 0.04)" << endl
+       << "  -Q --accumulator-share F   share of an accumulator's memory for"
+       << endl
+       << "                             queued samples (default: 0.1)" << endl
+       << "  -N --shards N              threads that decode worker messages"
+       << endl
+       << "                             (default: 0, on the event loop)" << endl
+       << "  -X --lambda-concurrency N  most Lambda workers to run at once"
+       << endl
+       << "                             (default: 1000)" << endl
+       << "  -O --lambda-connections N  connections to invoke workers over"
+       << endl
+       << "                             (default: 8)" << endl
        << "  -h --help                  show help information" << endl;
 
   exit( exit_code );
@@ -889,6 +1093,17 @@ int main( int argc, char* argv[] )
   vector<string> memcached_servers;
   vector<pair<string, uint32_t>> engines;
 
+  optional<seconds> deadline;
+  optional<double> cost_budget;
+  double worker_cost = LAMBDA_UNIT_COST;
+
+  uint64_t worker_memory = LAMBDA_MEMORY_SIZE;
+  double tracer_work_share = TRACER_WORK_SHARE;
+  double accumulator_work_share = ACCUMULATOR_WORK_SHARE;
+  size_t message_shards = 0;
+  size_t lambda_concurrency = LAMBDA_CONCURRENCY_LIMIT;
+  size_t lambda_connections = LAMBDA_CONNECTIONS;
+
   struct option long_options[] = {
     { "port", required_argument, nullptr, 'p' },
     { "client-port", required_argument, nullptr, 'P' },
@@ -919,17 +1134,27 @@ int main( int argc, char* argv[] )
     { "memcached-server", required_argument, nullptr, 'd' },
     { "engine", required_argument, nullptr, 'E' },
     { "auto-name", required_argument, nullptr, 'A' },
+    { "deadline", required_argument, nullptr, 'Y' },
+    { "budget", required_argument, nullptr, 'U' },
+    { "worker-cost", required_argument, nullptr, 'K' },
+    { "worker-memory", required_argument, nullptr, 'W' },
+    { "tracer-share", required_argument, nullptr, 'R' },
+    { "accumulator-share", required_argument, nullptr, 'Q' },
+    { "shards", required_argument, nullptr, 'N' },
+    { "lambda-concurrency", required_argument, nullptr, 'X' },
+    { "lambda-connections", required_argument, nullptr, 'O' },
     { "help", no_argument, nullptr, 'h' },
     { nullptr, 0, nullptr, 0 },
   };
 
   while ( true ) {
-    const int opt
-      = getopt_long( argc,
-                     argv,
-                     "p:P:i:r:b:m:G:D:a:F:S:M:s:L:c:C:t:j:T:n:J:d:E:q:B:A:wgh",
-                     long_options,
-                     nullptr );
+    const int opt = getopt_long(
+      argc,
+      argv,
+      "p:P:i:r:b:m:G:D:a:F:S:M:s:L:c:C:t:j:T:n:J:d:E:q:B:A:Y:U:K:W:R:Q:N:X:O:"
+      "wgh",
+      long_options,
+      nullptr );
 
     if ( opt == -1 ) {
       break;
@@ -963,6 +1188,15 @@ int main( int argc, char* argv[] )
       case 'd': memcached_servers.emplace_back(optarg); break;
       case 'E': engines.emplace_back(optarg, max_jobs_on_engine); break;
       case 'A': auto_name_log_dir_tag = optarg; break;
+      case 'Y': deadline = seconds{stoul(optarg)}; break;
+      case 'U': cost_budget = stod(optarg); break;
+      case 'K': worker_cost = stod(optarg); break;
+      case 'W': worker_memory = stoull(optarg) * 1024 * 1024; break;
+      case 'R': tracer_work_share = stod(optarg); break;
+      case 'Q': accumulator_work_share = stod(optarg); break;
+      case 'N': message_shards = stoul(optarg); break;
+      case 'X': lambda_concurrency = stoul(optarg); break;
+      case 'O': lambda_connections = stoul(optarg); break;
       case 'h': usage(argv[0], EXIT_SUCCESS); break;
       case 'C': alt_scene_file = optarg; break;
         // clang-format on
@@ -1026,6 +1260,10 @@ int main( int argc, char* argv[] )
     }
   } else if ( scheduler_name == "dynamic" ) {
     scheduler = make_unique<DynamicScheduler>();
+  } else if ( scheduler_name == "queueing" ) {
+    scheduler = make_unique<QueueingScheduler>();
+  } else if ( scheduler_name == "colocation" ) {
+    scheduler = make_unique<CoLocationScheduler>();
   } else if ( scheduler_name == "rootonly" ) {
     scheduler = make_unique<RootOnlyScheduler>();
   } else if ( scheduler_name == "null" ) {
@@ -1038,6 +1276,11 @@ int main( int argc, char* argv[] )
        || ray_generators < 0 || accumulators < 0 || samples_per_pixel < 0
        || max_path_depth < 0 || bagging_delay <= 0s || ray_log_rate < 0
        || ray_log_rate > 1.0 || bag_log_rate < 0 || bag_log_rate > 1.0
+       || ( deadline and cost_budget ) || worker_cost <= 0
+       || worker_memory == 0 || tracer_work_share <= 0
+       || tracer_work_share > 1 || accumulator_work_share <= 0
+       || accumulator_work_share > 1 || lambda_concurrency == 0
+       || lambda_connections == 0
        || public_ip.empty() || storage_backend_uri.empty() || region.empty()
        || new_tile_threshold == 0
        || ( crop_window.has_value() && pixels_per_tile != 0
@@ -1062,7 +1305,11 @@ int main( int argc, char* argv[] )
                                  tile_size,         seconds { timeout },
                                  job_summary_path,  new_tile_threshold,
                                  alt_scene_file,    move( memcached_servers ),
-                                 move( engines ) };
+                                 move( engines ),   deadline,
+                                 cost_budget,       worker_cost,
+                                 worker_memory,     tracer_work_share,
+                                 accumulator_work_share, message_shards,
+                                 lambda_concurrency, lambda_connections };
 
   try {
     master = make_unique<LambdaMaster>( listen_port,
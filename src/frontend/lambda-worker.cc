@@ -5,12 +5,16 @@
 #include <filesystem>
 #include <getopt.h>
 #include <signal.h>
-#include <streambuf>
 #include <sys/mman.h>
 
+#include "common/invocation.hh"
 #include "messages/utils.hh"
+#include "net/transfer_local.hh"
 #include "net/transfer_mcd.hh"
 #include "net/transfer_s3.hh"
+#include "storage/backend_local.hh"
+#include "storage/backend_s3.hh"
+#include "util/fileutils.hh"
 
 using namespace std;
 using namespace chrono;
@@ -20,6 +24,20 @@ using namespace meow;
 
 using OpCode = Message::OpCode;
 
+unique_ptr<TransferAgent> make_transfer_agent( const StorageBackend& backend,
+                                               const size_t thread_count = 8,
+                                               const bool public_read = false )
+{
+  if ( auto s3 = dynamic_cast<const S3StorageBackend*>( &backend ) ) {
+    return make_unique<S3TransferAgent>( *s3, thread_count, public_read );
+  } else if ( auto local
+              = dynamic_cast<const LocalStorageBackend*>( &backend ) ) {
+    return make_unique<LocalTransferAgent>( *local, thread_count );
+  }
+
+  throw runtime_error( "no transfer agent for this storage backend" );
+}
+
 LambdaWorker::LambdaWorker( const string& coordinator_ip,
                             const uint16_t coordinator_port,
                             const string& storage_uri,
@@ -33,27 +51,24 @@ LambdaWorker::LambdaWorker( const string& coordinator_ip,
     socket.connect( this->coordinator_addr );
     return socket;
   }() )
-  , storage_backend_info( storage_uri )
-  , scene_storage_backend( {},
-                           storage_backend_info.bucket,
-                           storage_backend_info.region,
-                           storage_backend_info.path )
-  , job_storage_backend( {},
-                         storage_backend_info.bucket,
-                         storage_backend_info.region )
+  , scene_storage_backend( StorageBackend::create_backend( storage_uri ) )
+  , job_storage_backend( StorageBackend::create_backend( storage_uri, true ) )
   , transfer_agent( [this]() -> unique_ptr<TransferAgent> {
     if ( not config.memcached_servers.empty() ) {
       return make_unique<memcached::TransferAgent>( config.memcached_servers );
     } else {
-      return make_unique<S3TransferAgent>( job_storage_backend );
+      return make_transfer_agent( *job_storage_backend );
     }
   }() )
   , samples_transfer_agent(
-      make_unique<S3TransferAgent>( job_storage_backend, 8, true ) )
+      make_transfer_agent( *job_storage_backend, 8, true ) )
   , output_transfer_agent(
-      make_unique<S3TransferAgent>( job_storage_backend, 1, true ) )
-  , scene_transfer_agent(
-      make_unique<S3TransferAgent>( scene_storage_backend, 2 ) )
+      make_transfer_agent( *job_storage_backend, 1, true ) )
+  , scene_transfer_agent( make_transfer_agent( *scene_storage_backend, 2 ) )
+  , trace_transfer_agent(
+      ( config.ray_log_rate > 0 or config.bag_log_rate > 0 )
+        ? make_transfer_agent( *job_storage_backend, 1 )
+        : nullptr )
   , worker_rule_categories( { loop.add_category( "Socket" ),
                               loop.add_category( "Message read" ),
                               loop.add_category( "Message write" ),
@@ -69,18 +84,21 @@ LambdaWorker::LambdaWorker( const string& coordinator_ip,
   FLAGS_log_prefix = false;
   google::InitGoogleLogging( log_base.c_str() );
 
-  if ( track_rays ) {
-    TLOG( RAY ) << "timestamp,pathId,hop,shadowRay,remainingBounces,workerId,"
-                   "treeletId,action,bag";
-  }
-
-  if ( track_bags ) {
-    TLOG( BAG ) << "timestamp,bagTreeletId,bagWorkerId,bagId,thisWorkerId,"
-                   "count,size,action";
+  if ( track_rays or track_bags ) {
+    loop.add_rule( "Trace records",
+                   Direction::In,
+                   trace_drain_timer,
+                   bind( &LambdaWorker::handle_trace_records, this ),
+                   [] { return true; } );
   }
 
   pbrt::PbrtOptions.nThreads = 1;
 
+  if ( not config.scene_hash.empty() and config.cache_size > 0 ) {
+    object_cache.emplace(
+      config.cache_directory, config.cache_size, config.scene_hash );
+  }
+
   scene.samples_per_pixel = config.samples_per_pixel;
   scene.max_depth = config.max_path_depth;
 
@@ -144,6 +162,12 @@ LambdaWorker::LambdaWorker( const string& coordinator_ip,
                  bind( &LambdaWorker::handle_scene_object_results, this ),
                  [this] { return !scene_loaded; } );
 
+  loop.add_rule( "Treelet loads",
+                 Direction::In,
+                 treelet_loaded_fd,
+                 bind( &LambdaWorker::handle_treelet_loads, this ),
+                 [this] { return !scene_loaded; } );
+
   loop.add_rule( "Pending messages",
                  bind( &LambdaWorker::handle_pending_messages, this ),
                  [this] { return scene_loaded && !pending_messages.empty(); } );
@@ -161,6 +185,17 @@ LambdaWorker::LambdaWorker( const string& coordinator_ip,
     [this] { this->terminate(); } );
 }
 
+void LambdaWorker::start_raytracing_threads()
+{
+  /* each thread leaves its stats in its own slot, even across swaps */
+  for ( size_t i = 0; i < 2; i++ ) {
+    const size_t idx = raytracing_thread_stats.size();
+    raytracing_thread_stats.emplace_back();
+    raytracing_threads.emplace_back(
+      bind( &LambdaWorker::handle_trace_queue, this, idx ) );
+  }
+}
+
 void LambdaWorker::shutdown_raytracing_threads()
 {
   for ( auto& t : raytracing_threads ) {
@@ -193,18 +228,29 @@ void LambdaWorker::shutdown_accumulation_threads()
   }
 }
 
+void LambdaWorker::shutdown_treelet_loaders()
+{
+  for ( auto& t : treelet_loaders ) {
+    if ( t.joinable() ) {
+      treelet_load_queue.enqueue( nullptr );
+    }
+  }
+
+  for ( auto& t : treelet_loaders ) {
+    if ( t.joinable() ) {
+      t.join();
+    }
+  }
+}
+
 void LambdaWorker::terminate()
 {
   shutdown_raytracing_threads();
   shutdown_accumulation_threads();
+  shutdown_treelet_loaders();
   terminated = true;
 }
 
-struct membuf : streambuf
-{
-  membuf( char* begin, char* end ) { this->setg( begin, begin, end ); }
-};
-
 void LambdaWorker::handle_scene_object_results()
 {
   if ( !scene_transfer_agent->eventfd().read_event() ) {
@@ -221,66 +267,215 @@ void LambdaWorker::handle_scene_object_results()
       continue;
     }
 
-    const auto& obj = obj_it->second;
+    if ( object_cache ) {
+      object_cache->put( object_name( obj_it->second ), action.second );
+    }
 
-    if ( obj.key.type != ObjectType::Treelet ) {
-      // let's write this object to disk
-      ofstream fout { scene::GetObjectName( obj.key.type, obj.key.id ),
-                      ios::binary };
-      fout.write( action.second.data(), action.second.length() );
-    } else {
-      // treelets should be loaded after everything else
-      downloaded_treelets.emplace_back( obj.key.id, move( action.second ) );
+    if ( obj_it->second.key.type != ObjectType::Treelet ) {
+      pending_dependencies--;
     }
 
+    store_scene_object( obj_it->second, move( action.second ) );
     pending_scene_objects.erase( obj_it );
   }
 
-  if ( pending_scene_objects.empty() ) { /* everything is loaded */
+  if ( not dependencies_on_disk and pending_dependencies == 0 ) {
+    start_treelet_loads();
+  }
+
+  finish_scene_setup();
+}
+
+void LambdaWorker::handle_treelet_loads()
+{
+  if ( treelet_loaded_fd.read_event() ) {
+    finish_scene_setup();
+  }
+}
+
+string LambdaWorker::object_name( const SceneObject& obj )
+{
+  return obj.alt_name.empty()
+           ? scene::GetObjectName( obj.key.type, obj.key.id )
+           : obj.alt_name;
+}
+
+void LambdaWorker::store_scene_object( const SceneObject& obj, string&& data )
+{
+  if ( obj.key.type != ObjectType::Treelet ) {
+    // let's write this object to disk
+    ofstream fout { scene::GetObjectName( obj.key.type, obj.key.id ),
+                    ios::binary };
+    fout.write( data.data(), data.length() );
+  } else {
+    store_treelet( obj.key.id, move( data ) );
+  }
+}
+
+void LambdaWorker::store_treelet( const TreeletId id, TreeletBuffer&& data )
+{
+  if ( dependencies_on_disk ) {
+    start_treelet_load( id, move( data ) );
+  } else {
+    // treelets might refer to objects we don't have yet
+    downloaded_treelets.emplace_back( id, move( data ) );
+  }
+}
+
+void LambdaWorker::start_treelet_load( const TreeletId id,
+                                       TreeletBuffer&& data )
+{
+  auto load = make_unique<TreeletLoad>( TreeletLoad { id, move( data ), {} } );
+  treelet_loads.emplace_back( id, load->result.get_future() );
+  treelet_load_queue.enqueue( move( load ) );
+}
+
+void LambdaWorker::handle_treelet_load_queue()
+{
+  unique_ptr<TreeletLoad> load;
+
+  while ( true ) {
+    treelet_load_queue.wait_dequeue( load );
+
+    if ( not load ) {
+      return;
+    }
+
+    char* bytes;
+    size_t length;
+
+    if ( auto downloaded = get_if<string>( &load->data ) ) {
+      bytes = downloaded->data();
+      length = downloaded->length();
+    } else {
+      /* a mapped file, read without an extra copy into the heap */
+      bytes = get<MMap_Region>( load->data ).addr();
+      length = get<MMap_Region>( load->data ).length();
+    }
+
+    /* the main thread picks up failures, too, when it calls get() */
+    try {
+      load->result.set_value(
+        scene::LoadTreelet( ".", load->id, bytes, length ) );
+    } catch ( ... ) {
+      load->result.set_exception( current_exception() );
+    }
+
+    /* the result is in by now, so the main thread will find it ready */
+    treelet_loaded_fd.write_event();
+  }
+}
+
+void LambdaWorker::start_treelet_loads()
+{
+  dependencies_on_disk = true;
+
+  /* the loader reads what the base scene sets up, so it goes first */
+  if ( not base_scene_loaded ) {
     scene.base = { working_directory.name(), scene.samples_per_pixel };
+    base_scene_loaded = true;
+  }
 
-    for ( auto& [id, data] : downloaded_treelets ) {
-      membuf buf( data.data(), data.data() + data.size() );
-      treelets.emplace(
-        id, scene::LoadTreelet( ".", id, data.data(), data.size() ) );
+  if ( treelet_loaders.empty() ) {
+    const size_t count = max( 1u, thread::hardware_concurrency() );
+
+    for ( size_t i = 0; i < count; i++ ) {
+      treelet_loaders.emplace_back(
+        bind( &LambdaWorker::handle_treelet_load_queue, this ) );
     }
+  }
 
-    downloaded_treelets.clear();
-    scene_transfer_agent.reset();
-    master_connection.push_request( { *worker_id, OpCode::GetObjects, "" } );
+  for ( auto& [id, data] : downloaded_treelets ) {
+    start_treelet_load( id, move( data ) );
+  }
 
-    scene_loaded = true;
+  downloaded_treelets.clear();
+}
 
-    tile_helper = { static_cast<uint32_t>( config.accumulators ),
-                    scene.base.sampleBounds,
-                    static_cast<uint32_t>( scene.samples_per_pixel ) };
+void LambdaWorker::finish_scene_setup()
+{
+  if ( scene_loaded or not dependencies_on_disk
+       or not pending_scene_objects.empty() ) {
+    return;
+  }
 
-    if ( is_accumulator ) {
-      loop.add_rule( "Upload output",
-                     Direction::In,
-                     upload_output_timer,
-                     bind( &LambdaWorker::handle_render_output, this ),
-                     [this] { return scene_loaded; } );
+  for ( auto& [id, load] : treelet_loads ) {
+    if ( load.wait_for( 0s ) != future_status::ready ) {
+      return;
+    }
+  }
 
-      samples_transfer_agent.reset();
+  /* the ray-tracing threads look treelets up as they go */
+  if ( pending_swap and pending_swap->keep_old_treelets() ) {
+    shutdown_raytracing_threads();
+    raytracing_threads.clear();
+  }
 
-      scene.base.camera->film->SetCroppedPixelBounds(
-        static_cast<pbrt::Bounds2i>( tile_helper.bounds( *tile_id ) ) );
+  for ( auto& [id, load] : treelet_loads ) {
+    treelets.emplace( id, load.get() );
+  }
 
-      for ( size_t i = 0; i < 2; i++ ) {
-        accumulation_threads.emplace_back(
-          bind( &LambdaWorker::handle_accumulation_queue, this ) );
-      }
-    } else {
-      output_transfer_agent.reset();
+  treelet_loads.clear();
+  scene_loaded = true;
 
-      /* starting the ray-tracing threads */
-      for ( size_t i = 0; i < 2; i++ ) {
-        raytracing_thread_stats.emplace_back();
-        raytracing_threads.emplace_back(
-          bind( &LambdaWorker::handle_trace_queue, this, i ) );
+  if ( pending_swap ) {
+    /* rays that were about to leave for the new treelet can stay */
+    const TreeletId new_treelet_id = pending_swap->new_treelet_id();
+
+    for ( auto out_it = out_queue.lower_bound( { new_treelet_id, nullopt } );
+          out_it != out_queue.end() and out_it->first.first == new_treelet_id;
+          out_it = out_queue.erase( out_it ) ) {
+      out_queue_size -= out_it->second.size();
+
+      for ( ; not out_it->second.empty(); out_it->second.pop() ) {
+        trace_queue_size++;
+        trace_queue.enqueue( move( out_it->second.front() ) );
       }
     }
+
+    pending_swap.reset();
+    start_raytracing_threads();
+
+    master_connection.push_request( { *worker_id, OpCode::SwapTreelet, "" } );
+    return;
+  }
+
+  master_connection.push_request( { *worker_id, OpCode::GetObjects, "" } );
+
+  tile_helper = { static_cast<uint32_t>( config.accumulators ),
+                  scene.base.sampleBounds,
+                  static_cast<uint32_t>( scene.samples_per_pixel ) };
+
+  if ( is_accumulator ) {
+    loop.add_rule( "Upload output",
+                   Direction::In,
+                   upload_output_timer,
+                   bind( &LambdaWorker::handle_render_output, this ),
+                   [this] { return scene_loaded; } );
+
+    samples_transfer_agent.reset();
+    scene_transfer_agent.reset();
+
+    scene.base.camera->film->SetCroppedPixelBounds(
+      static_cast<pbrt::Bounds2i>( tile_helper.bounds( *tile_id ) ) );
+
+    for ( size_t i = 0; i < 2; i++ ) {
+      accumulation_threads.emplace_back(
+        bind( &LambdaWorker::handle_accumulation_queue, this ) );
+    }
+  } else {
+    /* the scene agent stays, in case we're told to swap treelets */
+    output_transfer_agent.reset();
+
+    start_raytracing_threads();
+  }
+}
+
+void LambdaWorker::mark_first_ray()
+{
+  if ( not first_ray_latency ) {
+    first_ray_latency = duration_cast<microseconds>( system_clock::now()
+                                                     - config.invoked_at );
   }
 }
 
@@ -296,6 +491,46 @@ void LambdaWorker::run()
   }
 }
 
+/* fetches the base scene objects before an invocation comes in */
+map<string, string> preload_base_objects( const string& storage_uri )
+{
+  const TempDirectory preload_dir { "/tmp/r2t2-preload" };
+  auto backend = StorageBackend::create_backend( storage_uri );
+
+  vector<storage::GetRequest> requests;
+  for ( const auto type : BASE_OBJECT_TYPES ) {
+    const auto name = scene::GetObjectName( type, 0 );
+    requests.emplace_back( name,
+                           filesystem::path( preload_dir.name() ) / name );
+  }
+
+  backend->get( requests );
+
+  map<string, string> objects;
+  for ( const auto& request : requests ) {
+    objects.emplace( request.object_key, roost::read_file( request.filename ) );
+    filesystem::remove( request.filename );
+  }
+
+  return objects;
+}
+
+/* blocks until the pool hands over an invocation, then closes the pipe */
+protobuf::InvocationPayload read_invocation( const int control_fd )
+{
+  FileDescriptor control { control_fd };
+  string payload;
+  string buffer( 4096, '\0' );
+
+  while ( not control.eof() ) {
+    payload.append( buffer, 0, control.read( { buffer } ) );
+  }
+
+  protobuf::InvocationPayload proto;
+  protoutil::from_json( payload, proto );
+  return proto;
+}
+
 void usage( const char* argv0, int exitCode )
 {
   cerr << "Usage: " << argv0 << " [OPTIONS]" << endl
@@ -311,6 +546,16 @@ void usage( const char* argv0, int exitCode )
        << "  -L --log-rays RATE         log ray actions" << endl
        << "  -B --log-bags RATE         log bag actions" << endl
        << "  -d --memcached-server      address for memcached" << endl
+       << "  -T --invoked-at US         invocation time (us since epoch)"
+       << endl
+       << "  -c --control-fd FD         wait for the invocation on FD" << endl
+       << "  -P --preload NAME          preload base objects from this backend"
+       << endl
+       << "  -H --scene-hash HASH       hash of the scene's base objects"
+       << endl
+       << "  -K --cache-dir DIR         scene object cache directory" << endl
+       << "  -C --cache-size MiB        scene object cache size (0 disables)"
+       << endl
        << "  -h --help                  show help information" << endl;
 
   exit( exitCode );
@@ -331,9 +576,17 @@ int main( int argc, char* argv[] )
   float ray_log_rate = 0.0;
   float bag_log_rate = 0.0;
   milliseconds bagging_delay = DEFAULT_BAGGING_DELAY;
+  optional<system_clock::time_point> invoked_at;
 
   vector<Address> memcached_servers;
 
+  optional<int> control_fd;
+  string preload_uri;
+
+  string scene_hash_str;
+  optional<filesystem::path> cache_directory;
+  optional<uint64_t> cache_size;
+
   struct option long_options[] = {
     { "port", required_argument, nullptr, 'p' },
     { "ip", required_argument, nullptr, 'i' },
@@ -346,41 +599,96 @@ int main( int argc, char* argv[] )
     { "log-bags", required_argument, nullptr, 'B' },
     { "directional", no_argument, nullptr, 'I' },
     { "memcached-server", required_argument, nullptr, 'd' },
+    { "invoked-at", required_argument, nullptr, 'T' },
+    { "control-fd", required_argument, nullptr, 'c' },
+    { "preload", required_argument, nullptr, 'P' },
+    { "scene-hash", required_argument, nullptr, 'H' },
+    { "cache-dir", required_argument, nullptr, 'K' },
+    { "cache-size", required_argument, nullptr, 'C' },
     { "help", no_argument, nullptr, 'h' },
     { nullptr, 0, nullptr, 0 },
   };
 
-  while ( true ) {
-    const int opt = getopt_long(
-      argc, argv, "p:i:s:S:M:L:b:B:d:q:hI", long_options, nullptr );
-
-    if ( opt == -1 )
-      break;
-
-    // clang-format off
-    switch (opt) {
-    case 'p': listen_port = stoi(optarg); break;
-    case 'i': public_ip = optarg; break;
-    case 's': storage_uri = optarg; break;
-    case 'q': accumulators = stoi(optarg); break;
-    case 'S': samples_per_pixel = stoi(optarg); break;
-    case 'M': max_path_depth = stoi(optarg); break;
-    case 'b': bagging_delay = milliseconds{stoul(optarg)}; break;
-    case 'L': ray_log_rate = stof(optarg); break;
-    case 'B': bag_log_rate = stof(optarg); break;
-    case 'I': PbrtOptions.directionalTreelets = true; break;
-    case 'h': usage(argv[0], EXIT_SUCCESS); break;
-    case 'd': {
-        string host;
-        uint16_t port = 11211;
-        tie(host, port) = Address::decompose(optarg);
-        memcached_servers.emplace_back(host, port);
+  auto parse_options = [&]( int argc_, char* argv_[] ) {
+    optind = 0; /* a warm worker parses its invocation as a second pass */
+
+    while ( true ) {
+      const int opt = getopt_long( argc_,
+                                   argv_,
+                                   "p:i:s:S:M:L:b:B:d:q:T:c:P:H:K:C:hI",
+                                   long_options,
+                                   nullptr );
+
+      if ( opt == -1 )
         break;
+
+      // clang-format off
+      switch (opt) {
+      case 'p': listen_port = stoi(optarg); break;
+      case 'i': public_ip = optarg; break;
+      case 's': storage_uri = optarg; break;
+      case 'q': accumulators = stoi(optarg); break;
+      case 'S': samples_per_pixel = stoi(optarg); break;
+      case 'M': max_path_depth = stoi(optarg); break;
+      case 'b': bagging_delay = milliseconds{stoul(optarg)}; break;
+      case 'L': ray_log_rate = stof(optarg); break;
+      case 'B': bag_log_rate = stof(optarg); break;
+      case 'I': PbrtOptions.directionalTreelets = true; break;
+      case 'c': control_fd = stoi(optarg); break;
+      case 'P': preload_uri = optarg; break;
+      case 'H': scene_hash_str = optarg; break;
+      case 'K': cache_directory = optarg; break;
+      case 'C': cache_size = stoull(optarg) * 1024 * 1024; break;
+      case 'h': usage(argv_[0], EXIT_SUCCESS); break;
+      case 'T': {
+          const microseconds since_epoch{stoull(optarg)};
+          invoked_at = system_clock::time_point{since_epoch};
+          break;
+      }
+
+      case 'd': {
+          string host;
+          uint16_t port = 11211;
+          tie(host, port) = Address::decompose(optarg);
+          memcached_servers.emplace_back(host, port);
+          break;
+      }
+
+      default: usage(argv_[0], EXIT_FAILURE);
+      }
+      // clang-format on
     }
+  };
+
+  parse_options( argc, argv );
+
+  map<string, string> preloaded_objects;
+
+  if ( control_fd ) {
+    /* a warm worker: everything up to here is done before the invocation */
+    try {
+      if ( not preload_uri.empty() ) {
+        preloaded_objects = preload_base_objects( preload_uri );
+      }
+
+      const auto payload = read_invocation( *control_fd );
+
+      if ( payload.scene_hash() != scene_hash( preloaded_objects ) ) {
+        preloaded_objects.clear();
+      }
 
-    default: usage(argv[0], EXIT_FAILURE);
+      vector<string> command = worker_command( payload, argv[0] );
+      vector<char*> command_argv;
+      for ( auto& arg : command ) {
+        command_argv.push_back( arg.data() );
+      }
+
+      command_argv.push_back( nullptr );
+      parse_options( command.size(), command_argv.data() );
+    } catch ( const exception& e ) {
+      print_exception( argv[0], e );
+      return EXIT_FAILURE;
     }
-    // clang-format on
   }
 
   if ( listen_port == 0 || accumulators < 0 || samples_per_pixel < 0
@@ -396,6 +704,21 @@ int main( int argc, char* argv[] )
                                bag_log_rate,      move( memcached_servers ),
                                accumulators };
 
+  if ( invoked_at ) {
+    config.invoked_at = *invoked_at;
+  }
+
+  config.preloaded_objects = move( preloaded_objects );
+  config.scene_hash = scene_hash_str;
+
+  if ( cache_directory ) {
+    config.cache_directory = *cache_directory;
+  }
+
+  if ( cache_size ) {
+    config.cache_size = *cache_size;
+  }
+
   try {
     worker = make_unique<LambdaWorker>(
       public_ip, listen_port, storage_uri, config );
@@ -1,21 +1,26 @@
 #include <cstdlib>
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
-#include <sstream>
-#include <streambuf>
 #include <string>
 
 #include <pbrt/core/geometry.h>
 #include <pbrt/main.h>
 
+#include "storage/backend_local.hh"
+#include "util/exception.hh"
+#include "util/file_descriptor.hh"
 #include "util/timer.hh"
 
 using namespace std;
 
-struct membuf : streambuf
+/* so that both runs start from disk, not from each other's page cache */
+void drop_from_page_cache( const string& path )
 {
-  membuf( char* begin, char* end ) { this->setg( begin, begin, end ); }
-};
+  FileDescriptor file { SystemCall( "open (" + path + ")",
+                                    open( path.c_str(), O_RDONLY ) ) };
+  posix_fadvise( file.fd_num(), 0, 0, POSIX_FADV_DONTNEED );
+}
 
 int main( int argc, char* argv[] )
 {
@@ -31,9 +36,15 @@ int main( int argc, char* argv[] )
     = path + "/"
       + pbrt::scene::GetObjectName( pbrt::ObjectType::Treelet, treelet_id );
 
+  auto& timer = global_timer();
+  pbrt::PbrtOptions.nThreads = 1;
+
+  /* (1) read the whole file into memory, then parse it from there */
+  drop_from_page_cache( treelet_path );
+
   vector<char> buffer;
   {
-    GlobalScopeTimer<Timer::Category::WaitingForEvent> _;
+    GlobalScopeTimer<Timer::Category::ReadingTreelet> _;
 
     ifstream fin { treelet_path, ios::binary | ios::ate };
     streamsize size = fin.tellg();
@@ -42,15 +53,24 @@ int main( int argc, char* argv[] )
     fin.read( buffer.data(), size );
   }
 
-  auto& timer = global_timer();
-
-  pbrt::PbrtOptions.nThreads = 1;
   {
     GlobalScopeTimer<Timer::Category::LoadingTreelet> _;
     auto treelet = pbrt::scene::LoadTreelet(
       path, treelet_id, buffer.data(), buffer.size() );
   }
 
+  buffer = {};
+
+  /* (2) mmap the file, then parse it from the mapping */
+  drop_from_page_cache( treelet_path );
+
+  {
+    GlobalScopeTimer<Timer::Category::MappingTreelet> _;
+    MMap_Region region = LocalStorageBackend::map_object( treelet_path );
+    auto treelet = pbrt::scene::LoadTreelet(
+      path, treelet_id, region.addr(), region.length() );
+  }
+
   cout << timer.summary() << endl;
 
   return EXIT_SUCCESS;
@@ -0,0 +1,368 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+/* A minimal S3-compatible object server for benchmarking and testing the
+   transfer stack locally. Object keys are the request paths; bucket names and
+   request signatures are ignored. Point the clients at it by setting
+   R2T2_S3_ENDPOINT=host:port, or by adding ?endpoint=host:port to an s3://
+   storage URI. */
+
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <getopt.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "net/address.hh"
+#include "net/http_request_parser.hh"
+#include "net/http_response.hh"
+#include "net/socket.hh"
+#include "util/exception.hh"
+#include "util/fileutils.hh"
+#include "util/simple_string_span.hh"
+
+using namespace std;
+using namespace chrono;
+
+namespace fs = std::filesystem;
+
+using Object = shared_ptr<const string>;
+
+class ObjectStore
+{
+public:
+  virtual void put( const string& key, string&& data ) = 0;
+  virtual Object get( const string& key ) = 0;
+  virtual bool remove( const string& key ) = 0;
+
+  /* keys that fail this are answered with 400 Bad Request */
+  virtual bool valid_key( const string& ) const { return true; }
+
+  virtual ~ObjectStore() {}
+};
+
+class MemoryObjectStore : public ObjectStore
+{
+private:
+  shared_mutex mutex_ {};
+  unordered_map<string, Object> objects_ {};
+
+public:
+  void put( const string& key, string&& data ) override
+  {
+    auto object = make_shared<const string>( move( data ) );
+    unique_lock<shared_mutex> lock { mutex_ };
+    objects_[key] = move( object );
+  }
+
+  Object get( const string& key ) override
+  {
+    shared_lock<shared_mutex> lock { mutex_ };
+    auto it = objects_.find( key );
+    return ( it != objects_.end() ) ? it->second : nullptr;
+  }
+
+  bool remove( const string& key ) override
+  {
+    unique_lock<shared_mutex> lock { mutex_ };
+    return objects_.erase( key ) > 0;
+  }
+};
+
+class DiskObjectStore : public ObjectStore
+{
+private:
+  fs::path root_;
+
+  /* keys may not lead out of the root */
+  static bool valid_relative_path( const fs::path& relative )
+  {
+    return not relative.empty() and not relative.is_absolute()
+           and *relative.begin() != "..";
+  }
+
+  fs::path path_for( const string& key ) const
+  {
+    const fs::path relative = fs::path { key }.lexically_normal();
+
+    if ( not valid_relative_path( relative ) ) {
+      throw runtime_error( "invalid object key: " + key );
+    }
+
+    return root_ / relative;
+  }
+
+public:
+  DiskObjectStore( const fs::path& root )
+    : root_( root )
+  {
+    fs::create_directories( root_ );
+  }
+
+  void put( const string& key, string&& data ) override
+  {
+    const fs::path path = path_for( key );
+    fs::create_directories( path.parent_path() );
+    roost::atomic_create( data, path );
+  }
+
+  Object get( const string& key ) override
+  {
+    const fs::path path = path_for( key );
+    if ( not fs::is_regular_file( path ) ) {
+      return nullptr;
+    }
+
+    return make_shared<const string>( roost::read_file( path ) );
+  }
+
+  bool remove( const string& key ) override
+  {
+    return fs::remove( path_for( key ) );
+  }
+
+  bool valid_key( const string& key ) const override
+  {
+    return valid_relative_path( fs::path { key }.lexically_normal() );
+  }
+};
+
+struct LinkShaping
+{
+  milliseconds latency { 0 };
+  double bandwidth { 0 }; /* bytes per second, zero means unlimited */
+};
+
+/* paces a byte stream to a fixed rate; idle time is not banked */
+class Pacer
+{
+private:
+  double rate_;
+  steady_clock::time_point next_ { steady_clock::now() };
+
+public:
+  Pacer( const double rate )
+    : rate_( rate )
+  {}
+
+  void pace( const size_t bytes )
+  {
+    if ( rate_ <= 0 ) {
+      return;
+    }
+
+    next_ = max( next_, steady_clock::now() );
+    next_ += duration_cast<steady_clock::duration>(
+      duration<double> { bytes / rate_ } );
+
+    this_thread::sleep_until( next_ );
+  }
+};
+
+static const string NO_SUCH_KEY
+  = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<Error><Code>NoSuchKey</Code></Error>";
+
+pair<string, Object> handle_request( HTTPRequest& request, ObjectStore& store )
+{
+  const string_view first_line = request.first_line();
+
+  const size_t method_end = first_line.find( ' ' );
+  const size_t target_end = first_line.find( ' ', method_end + 1 );
+
+  if ( method_end == string::npos or target_end == string::npos ) {
+    return { "HTTP/1.1 400 Bad Request", nullptr };
+  }
+
+  const string_view method = first_line.substr( 0, method_end );
+  string key { first_line.substr( method_end + 1,
+                                  target_end - method_end - 1 ) };
+
+  key = key.substr( 0, key.find( '?' ) );
+  if ( not key.empty() and key.front() == '/' ) {
+    key.erase( 0, 1 );
+  }
+
+  if ( key.empty() or not store.valid_key( key ) ) {
+    return { "HTTP/1.1 400 Bad Request", nullptr };
+  }
+
+  if ( method == "PUT" ) {
+    store.put( key, move( request.body() ) );
+    return { "HTTP/1.1 200 OK", nullptr };
+  } else if ( method == "GET" or method == "HEAD" ) {
+    Object object = store.get( key );
+
+    if ( not object ) {
+      return { "HTTP/1.1 404 Not Found",
+               make_shared<const string>( NO_SUCH_KEY ) };
+    }
+
+    return { "HTTP/1.1 200 OK", move( object ) };
+  } else if ( method == "DELETE" ) {
+    store.remove( key );
+    return { "HTTP/1.1 204 No Content", nullptr };
+  }
+
+  return { "HTTP/1.1 405 Method Not Allowed", nullptr };
+}
+
+void serve_connection( TCPSocket socket,
+                       ObjectStore& store,
+                       const LinkShaping& shaping )
+{
+  constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+  HTTPRequestParser requests;
+  Pacer inbound { shaping.bandwidth };
+  Pacer outbound { shaping.bandwidth };
+
+  string buffer( CHUNK_SIZE, '\0' );
+  simple_string_span buffer_span { buffer };
+  string headers;
+
+  try {
+    while ( true ) {
+      const size_t read_count = socket.read( buffer_span );
+      if ( read_count == 0 ) {
+        break;
+      }
+
+      inbound.pace( read_count );
+      requests.parse( buffer_span.substr( 0, read_count ) );
+
+      while ( not requests.empty() ) {
+        const bool is_head = requests.front().is_head();
+        auto [status, body] = handle_request( requests.front(), store );
+        requests.pop();
+
+        const string_view body_view = body ? string_view { *body } : "";
+
+        HTTPResponse response {
+          move( status ),
+          { { "Content-Length", to_string( body_view.length() ) },
+            { "Server", "r2t2-s3-server" } },
+          {}
+        };
+
+        this_thread::sleep_for( shaping.latency );
+
+        response.serialize_headers( headers );
+        socket.write_all( headers );
+
+        if ( is_head ) {
+          continue;
+        }
+
+        for ( size_t offset = 0; offset < body_view.length();
+              offset += CHUNK_SIZE ) {
+          const auto chunk = body_view.substr( offset, CHUNK_SIZE );
+          outbound.pace( chunk.length() );
+          socket.write_all( chunk );
+        }
+      }
+    }
+  } catch ( const exception& ex ) {
+    cerr << "Connection error: " << ex.what() << endl;
+  }
+}
+
+void usage( const char* argv0, int exitCode )
+{
+  cerr << "Usage: " << argv0 << " [OPTIONS]" << endl
+       << endl
+       << "Options:" << endl
+       << "  -i --ip IPSTRING           ip to listen on (default: 0.0.0.0)"
+       << endl
+       << "  -p --port PORT             port to listen on (default: 9000)"
+       << endl
+       << "  -d --directory DIR         store objects on disk under DIR"
+       << endl
+       << "                             (default: in memory)" << endl
+       << "  -l --latency MS            added latency per request" << endl
+       << "  -b --bandwidth MBPS        per-connection bandwidth limit" << endl
+       << "  -h --help                  show help information" << endl;
+
+  exit( exitCode );
+}
+
+int main( int argc, char* argv[] )
+{
+  int exit_status = EXIT_SUCCESS;
+
+  string listen_ip = "0.0.0.0";
+  uint16_t listen_port = 9000;
+  string directory;
+  LinkShaping shaping;
+
+  struct option long_options[] = {
+    { "ip", required_argument, nullptr, 'i' },
+    { "port", required_argument, nullptr, 'p' },
+    { "directory", required_argument, nullptr, 'd' },
+    { "latency", required_argument, nullptr, 'l' },
+    { "bandwidth", required_argument, nullptr, 'b' },
+    { "help", no_argument, nullptr, 'h' },
+    { nullptr, 0, nullptr, 0 },
+  };
+
+  while ( true ) {
+    const int opt
+      = getopt_long( argc, argv, "i:p:d:l:b:h", long_options, nullptr );
+
+    if ( opt == -1 )
+      break;
+
+    // clang-format off
+    switch (opt) {
+    case 'i': listen_ip = optarg; break;
+    case 'p': listen_port = stoi(optarg); break;
+    case 'd': directory = optarg; break;
+    case 'l': shaping.latency = milliseconds{stoul(optarg)}; break;
+    case 'b': shaping.bandwidth = stod(optarg) * 1e6 / 8; break;
+    case 'h': usage(argv[0], EXIT_SUCCESS); break;
+    default: usage(argv[0], EXIT_FAILURE);
+    }
+    // clang-format on
+  }
+
+  if ( listen_port == 0 or shaping.bandwidth < 0 ) {
+    usage( argv[0], EXIT_FAILURE );
+  }
+
+  /* a client hanging up mid-response shouldn't take the server down */
+  signal( SIGPIPE, SIG_IGN );
+
+  try {
+    unique_ptr<ObjectStore> store;
+
+    if ( directory.empty() ) {
+      store = make_unique<MemoryObjectStore>();
+    } else {
+      store = make_unique<DiskObjectStore>( directory );
+    }
+
+    TCPSocket listener;
+    listener.set_reuseaddr();
+    listener.bind( { listen_ip, listen_port } );
+    listener.listen( 128 );
+
+    cout << "\u2192 Serving objects "
+         << ( directory.empty() ? "from memory" : "from " + directory )
+         << " on " << listener.local_address().to_string() << endl;
+
+    while ( true ) {
+      thread( serve_connection, listener.accept(), ref( *store ), shaping )
+        .detach();
+    }
+  } catch ( const exception& e ) {
+    print_exception( argv[0], e );
+    exit_status = EXIT_FAILURE;
+  }
+
+  return exit_status;
+}
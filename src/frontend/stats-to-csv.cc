@@ -0,0 +1,222 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "common/trace.hh"
+#include "storage/backend_local.hh"
+#include "util/column_log.hh"
+#include "util/exception.hh"
+
+using namespace std;
+using namespace r2t2;
+
+void usage( char* argv0 )
+{
+  cerr << "Usage: " << argv0 << " LOGS-DIR|LOG..." << endl;
+}
+
+/* the workers' trace chunks all go into rays.csv and bags.csv */
+class TraceCSV
+{
+private:
+  filesystem::path directory_;
+  optional<ofstream> rays_ {};
+  optional<ofstream> bags_ {};
+  uint64_t records_ { 0 };
+
+  ofstream& rays();
+  ofstream& bags();
+
+public:
+  TraceCSV( const filesystem::path& directory )
+    : directory_( directory )
+  {}
+
+  void add_chunk( const filesystem::path& path );
+  uint64_t records() const { return records_; }
+};
+
+ofstream& TraceCSV::rays()
+{
+  if ( not rays_ ) {
+    rays_.emplace( directory_ / "rays.csv", ios::trunc );
+    *rays_ << fixed << setprecision( 3 )
+           << "timestamp,pathId,hop,shadowRay,remainingBounces,workerId,"
+              "treeletId,action,bag\n";
+  }
+
+  return *rays_;
+}
+
+ofstream& TraceCSV::bags()
+{
+  if ( not bags_ ) {
+    bags_.emplace( directory_ / "bags.csv", ios::trunc );
+    *bags_ << fixed << setprecision( 3 )
+           << "timestamp,bagTreeletId,bagWorkerId,bagId,thisWorkerId,count,"
+              "size,action\n";
+  }
+
+  return *bags_;
+}
+
+void TraceCSV::add_chunk( const filesystem::path& path )
+{
+  const string data = LocalStorageBackend::read_object( path );
+
+  TraceHeader header;
+  if ( data.length() < sizeof( header )
+       or ( data.length() - sizeof( header ) ) % sizeof( TraceRecord ) ) {
+    throw runtime_error( path.string() + " is not a trace chunk" );
+  }
+
+  memcpy( &header, data.data(), sizeof( header ) );
+
+  if ( string_view { header.magic, sizeof( header.magic ) }
+       != TraceHeader::MAGIC ) {
+    throw runtime_error( path.string() + " is not a trace chunk" );
+  }
+
+  if ( header.dropped_records ) {
+    cerr << path.string() << ": the worker had dropped "
+         << header.dropped_records << " records by then" << endl;
+  }
+
+  for ( size_t offset = sizeof( header ); offset < data.length();
+        offset += sizeof( TraceRecord ) ) {
+    TraceRecord r;
+    memcpy( &r, data.data() + offset, sizeof( r ) );
+
+    /* timestamps used to be in milliseconds */
+    const double timestamp = r.timestamp / 1000.0;
+
+    if ( r.kind == TraceRecord::Kind::Ray ) {
+      rays() << timestamp << ',' << r.path_id << ',' << r.hop << ','
+             << ( ( r.flags & TraceRecord::SHADOW_RAY ) ? 1 : 0 ) << ','
+             << static_cast<int>( r.remaining_bounces ) << ','
+             << header.worker_id << ',' << r.treelet_id << ','
+             << action_name( static_cast<RayAction>( r.action ) ) << ','
+             << ( ( r.flags & TraceRecord::HAS_BAG ) ? r.bag().str( "" ) : "" )
+             << '\n';
+    } else {
+      bags() << timestamp << ',' << r.bag_treelet_id << ',' << r.bag_worker_id
+             << ',' << r.bag_id << ',' << header.worker_id << ','
+             << r.ray_count << ',' << r.bag_size << ','
+             << action_name( static_cast<BagAction>( r.action ) ) << '\n';
+    }
+
+    records_++;
+  }
+}
+
+/* writes out <name>.csv next to <name>.cols, with the same columns */
+void convert( const filesystem::path& path )
+{
+  column_log::Reader reader { path.string() };
+  const auto& columns = reader.columns();
+
+  filesystem::path csv_path { path };
+  csv_path.replace_extension( ".csv" );
+
+  ofstream fout { csv_path, ios::trunc };
+  fout << fixed << setprecision( 2 );
+
+  for ( size_t i = 0; i < columns.size(); i++ ) {
+    fout << ( i ? "," : "" ) << columns[i].name;
+  }
+
+  fout << '\n';
+
+  size_t rows = 0;
+
+  while ( reader.read_chunk() ) {
+    for ( size_t r = 0; r < reader.rows(); r++ ) {
+      for ( size_t i = 0; i < columns.size(); i++ ) {
+        if ( i ) {
+          fout << ',';
+        }
+
+        switch ( columns[i].type ) {
+          case column_log::Type::Int:
+            if ( reader.ints( i )[r] != column_log::NONE ) {
+              fout << reader.ints( i )[r];
+            }
+
+            break;
+
+          case column_log::Type::Double:
+            fout << reader.doubles( i )[r];
+            break;
+
+          case column_log::Type::String:
+            fout << reader.strings( i )[r];
+            break;
+        }
+      }
+
+      fout << '\n';
+    }
+
+    rows += reader.rows();
+  }
+
+  cerr << path.string() << " \u2192 " << csv_path.string() << " (" << rows
+       << " rows)" << endl;
+}
+
+int main( int argc, char* argv[] )
+{
+  if ( argc <= 0 ) {
+    abort();
+  }
+
+  if ( argc < 2 ) {
+    usage( argv[0] );
+    return EXIT_FAILURE;
+  }
+
+  try {
+    for ( int i = 1; i < argc; i++ ) {
+      const filesystem::path path { argv[i] };
+
+      if ( not filesystem::is_directory( path ) ) {
+        if ( path.extension() == ".trace" ) {
+          TraceCSV { path.parent_path() }.add_chunk( path );
+        } else {
+          convert( path );
+        }
+
+        continue;
+      }
+
+      TraceCSV traces { path };
+
+      for ( const auto& entry : filesystem::directory_iterator( path ) ) {
+        if ( not entry.is_regular_file() ) {
+          continue;
+        }
+
+        if ( entry.path().extension() == ".cols" ) {
+          convert( entry.path() );
+        } else if ( entry.path().extension() == ".trace" ) {
+          traces.add_chunk( entry.path() );
+        }
+      }
+
+      if ( traces.records() ) {
+        cerr << path.string() << " \u2192 rays.csv, bags.csv ("
+             << traces.records() << " records)" << endl;
+      }
+    }
+  } catch ( const exception& ex ) {
+    print_exception( argv[0], ex );
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,257 @@
+#include <csignal>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+
+#include "common/invocation.hh"
+#include "lambda-master.hh"
+#include "messages/utils.hh"
+#include "net/http_client.hh"
+#include "net/session.hh"
+#include "util/exception.hh"
+#include "util/pipe.hh"
+
+using namespace std;
+using namespace chrono;
+using namespace r2t2;
+
+LambdaMaster::Engine::Engine( const string& name_, const uint32_t max_jobs_ )
+  : name( name_ )
+  , max_jobs( max_jobs_ )
+{
+  if ( max_jobs == 0 ) {
+    throw runtime_error( "engine " + name + " cannot run any jobs" );
+  }
+
+  if ( name != "local" ) {
+    const auto [host, port] = Address::decompose( name );
+    server_address.emplace( host, to_string( port ) );
+  }
+}
+
+void LambdaMaster::setup_engines( const protobuf::InvocationPayload& payload )
+{
+  for ( const auto& [name, max_jobs] : config.engines ) {
+    engines.emplace_back( name, max_jobs );
+  }
+
+  /* prefer the worker binary that was built next to this one */
+  string worker_program = "r2t2-lambda-worker";
+  const auto sibling
+    = filesystem::read_symlink( "/proc/self/exe" ).parent_path()
+      / worker_program;
+
+  if ( filesystem::exists( sibling ) ) {
+    worker_program = sibling.string();
+  }
+
+  local_worker_program = worker_program;
+  local_worker_command = worker_command( payload, worker_program );
+  local_invocation = payload;
+
+  /* a warm worker that died closes its end of the control pipe; writing
+     to it should throw rather than kill us */
+  signal( SIGPIPE, SIG_IGN );
+
+  for ( size_t i = 0; i < engines.size(); i++ ) {
+    if ( not engines[i].server_address ) {
+      refill_local_pool( i );
+    }
+  }
+}
+
+void LambdaMaster::refill_local_pool( const size_t engine_index )
+{
+  const Engine& engine = engines[engine_index];
+
+  size_t warm = 0;
+  for ( const auto& worker : warm_local_workers ) {
+    warm += ( worker.engine_index == engine_index );
+  }
+
+  for ( ; engine.running_jobs + warm < engine.max_jobs; warm++ ) {
+    auto [control_read, control_write] = make_pipe();
+
+    /* only this worker may hold the write end, or it never sees EOF */
+    SystemCall( "fcntl",
+                fcntl( control_write.fd_num(), F_SETFD, FD_CLOEXEC ) );
+
+    vector<string> command { local_worker_program,
+                             "--control-fd",
+                             to_string( control_read.fd_num() ) };
+
+    /* without a scene hash, the worker would drop what it preloaded */
+    if ( not local_invocation.scene_hash().empty() ) {
+      command.insert( command.end(), { "--preload", storage_backend_uri } );
+    }
+
+    warm_local_workers.push_back(
+      { engine_index,
+        ChildProcess { "r2t2-lambda-worker", command, true },
+        move( control_write ) } );
+  }
+}
+
+size_t LambdaMaster::invoke_workers_on_engines( const size_t n )
+{
+  size_t launched = 0;
+
+  /* round-robin over the engines that have free slots */
+  for ( size_t tried = 0; launched < n and tried < engines.size(); ) {
+    const size_t engine_index = next_engine;
+    Engine& engine = engines[engine_index];
+    next_engine = ( next_engine + 1 ) % engines.size();
+
+    if ( engine.running_jobs >= engine.max_jobs ) {
+      tried++;
+      continue;
+    }
+
+    if ( engine.server_address ) {
+      launch_remote_worker( engine_index );
+    } else {
+      launch_local_worker( engine_index );
+    }
+
+    launched++;
+    tried = 0;
+  }
+
+  return launched;
+}
+
+void LambdaMaster::launch_local_worker( const size_t engine_index )
+{
+  const auto invoked_at
+    = duration_cast<microseconds>( system_clock::now().time_since_epoch() )
+        .count();
+
+  for ( auto it = warm_local_workers.begin();
+        it != warm_local_workers.end(); ) {
+    if ( it->engine_index != engine_index ) {
+      it++;
+      continue;
+    }
+
+    protobuf::InvocationPayload payload = local_invocation;
+    payload.set_invoked_at( invoked_at );
+
+    try {
+      /* the worker reads up to EOF, i.e. until `control` goes away */
+      it->control.write_all( protoutil::to_json( payload ) );
+    } catch ( const exception& ex ) {
+      cerr << "Warm local worker (pid " << it->process.pid()
+           << ") is gone: " << ex.what() << endl;
+      it = warm_local_workers.erase( it );
+      continue;
+    }
+
+    local_workers.push_back( { engine_index, move( it->process ) } );
+    warm_local_workers.erase( it );
+    engines[engine_index].running_jobs++;
+    return;
+  }
+
+  /* no warm worker is left for this engine; start one from scratch */
+  auto command = local_worker_command;
+  command.insert( command.end(), { "--invoked-at", to_string( invoked_at ) } );
+
+  /* not forked: the master may have other threads by now (--shards), and
+     workers' output would garble the status bar */
+  local_workers.push_back(
+    { engine_index, ChildProcess { "r2t2-lambda-worker", command, true } } );
+
+  engines[engine_index].running_jobs++;
+}
+
+void LambdaMaster::launch_remote_worker( const size_t engine_index )
+{
+  Engine& engine = engines[engine_index];
+
+  TCPSocket socket;
+  socket.set_blocking( false );
+  socket.connect( *engine.server_address );
+  engine_clients.emplace_back( TCPSession { move( socket ) } );
+
+  auto client_it = prev( engine_clients.end() );
+
+  /* the server responds once the worker has exited, which frees the slot */
+  auto finished = make_shared<bool>( false );
+  auto job_done = [this, client_it, engine_index, finished] {
+    if ( *finished ) {
+      return;
+    }
+
+    *finished = true;
+    engines[engine_index].running_jobs--;
+    finished_engine_clients.push_back( client_it );
+  };
+
+  client_it->install_rules(
+    loop,
+    engine_rule_categories,
+    [job_done]( HTTPResponse&& ) { job_done(); },
+    job_done,
+    [job_done, name = engine.name] {
+      cerr << "Engine " << name << " failed to run a worker." << endl;
+      job_done();
+    } );
+
+  client_it->push_request(
+    { "POST /invoke HTTP/1.1",
+      { { "Host", engine.name },
+        { "Content-Type", "application/json" },
+        { "Content-Length", to_string( invocation_payload.length() ) } },
+      string { invocation_payload } } );
+
+  engine.running_jobs++;
+}
+
+void LambdaMaster::handle_local_worker_exits()
+{
+  for ( auto it = warm_local_workers.begin();
+        it != warm_local_workers.end(); ) {
+    if ( it->process.waitable() ) {
+      it->process.wait( true );
+    }
+
+    if ( it->process.terminated() ) {
+      cerr << "Warm local worker (pid " << it->process.pid()
+           << ") exited before it was used." << endl;
+      it = warm_local_workers.erase( it );
+    } else {
+      it++;
+    }
+  }
+
+  set<size_t> freed_engines;
+
+  for ( auto it = local_workers.begin(); it != local_workers.end(); ) {
+    ChildProcess& process = it->process;
+
+    if ( process.waitable() ) {
+      process.wait( true );
+    }
+
+    if ( not process.terminated() ) {
+      it++;
+      continue;
+    }
+
+    if ( process.died_on_signal() or process.exit_status() != 0 ) {
+      cerr << "Local worker (pid " << process.pid() << ") exited abnormally."
+           << endl;
+    }
+
+    engines[it->engine_index].running_jobs--;
+    freed_engines.insert( it->engine_index );
+    it = local_workers.erase( it );
+  }
+
+  /* a replacement for a worker that went away starts warm, too */
+  if ( state_ == State::Active ) {
+    for ( const size_t engine_index : freed_engines ) {
+      refill_local_pool( engine_index );
+    }
+  }
+}
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <iostream>
+
+#include "lambda-master.hh"
+#include "net/http_client.hh"
+#include "net/lambda.hh"
+#include "net/session.hh"
+
+using namespace std;
+using namespace chrono;
+using namespace r2t2;
+
+void LambdaMaster::invoke_workers( const size_t n_workers )
+{
+  pending_invocations += n_workers;
+  dispatch_invocations();
+}
+
+size_t LambdaMaster::requested_workers()
+{
+  /* a worker that never showed up shouldn't hold back its replacement */
+  const auto now = steady_clock::now();
+  while ( not starting_workers.empty()
+          and now - starting_workers.front() > WORKER_STARTUP_TIMEOUT ) {
+    starting_workers.pop_front();
+  }
+
+  return pending_invocations + invocations_in_flight
+         + starting_workers.size();
+}
+
+void LambdaMaster::dispatch_invocations()
+{
+  if ( pending_invocations == 0 ) {
+    return;
+  }
+
+  if ( not config.engines.empty() ) {
+    /* the rest wait for a slot to free up */
+    const size_t launched = invoke_workers_on_engines( pending_invocations );
+    pending_invocations -= launched;
+    starting_workers.insert(
+      starting_workers.end(), launched, steady_clock::now() );
+    return;
+  }
+
+  if ( steady_clock::now() < invocation_backoff_until ) {
+    return;
+  }
+
+  /* every worker we've asked for counts against the concurrency limit */
+  size_t alive = invocations_in_flight + starting_workers.size();
+  for ( const auto& [role, count] : Worker::active_count ) {
+    alive += count;
+  }
+
+  size_t allowed = min( { pending_invocations,
+                          config.lambda_concurrency > alive
+                            ? config.lambda_concurrency - alive
+                            : 0,
+                          invocation_window > invocations_in_flight
+                            ? invocation_window - invocations_in_flight
+                            : 0 } );
+
+  /* round-robin over the connections that have room in their pipeline */
+  for ( size_t skipped = 0;
+        allowed > 0 and skipped < lambda_connections.size(); ) {
+    const size_t index = next_lambda_connection;
+    auto& connection = lambda_connections[index];
+    next_lambda_connection = ( index + 1 ) % lambda_connections.size();
+
+    if ( connection.closed ) {
+      connection.client.reset();
+      connection.closed = false;
+    }
+
+    if ( not connection.client ) {
+      open_lambda_connection( index );
+    }
+
+    if ( connection.in_flight >= INVOCATION_PIPELINE_DEPTH ) {
+      skipped++;
+      continue;
+    }
+
+    connection.client->push_request(
+      LambdaInvocationRequest(
+        aws_credentials,
+        aws_region,
+        lambda_function_name,
+        invocation_payload,
+        LambdaInvocationRequest::InvocationType::EVENT,
+        LambdaInvocationRequest::LogType::NONE )
+        .to_http_request() );
+
+    connection.in_flight++;
+    invocations_in_flight++;
+    pending_invocations--;
+    allowed--;
+    skipped = 0;
+  }
+}
+
+void LambdaMaster::open_lambda_connection( const size_t index )
+{
+  auto& connection = lambda_connections[index];
+
+  TCPSocket socket;
+  socket.set_blocking( false );
+  socket.connect( aws_address );
+
+  connection.client = make_unique<HTTPClient<SSLSession>>(
+    SSLSession { ssl_context.make_SSL_handle(), move( socket ) } );
+
+  connection.client->install_rules(
+    loop,
+    https_rule_categories,
+    [this, index]( HTTPResponse&& response ) {
+      handle_invocation_response( index, response );
+    },
+    [this, index] { handle_lambda_connection_close( index ); },
+    [this, index] { handle_lambda_connection_close( index ); } );
+}
+
+void LambdaMaster::handle_invocation_response( const size_t index,
+                                               const HTTPResponse& response )
+{
+  auto& connection = lambda_connections[index];
+
+  /* already counted as lost when the connection went away */
+  if ( connection.closed ) {
+    return;
+  }
+
+  connection.in_flight--;
+  invocations_in_flight--;
+
+  const auto status = response.status_code();
+  const size_t max_window = lambda_connections.size()
+                            * INVOCATION_PIPELINE_DEPTH;
+
+  if ( status == "202" or status == "200" ) {
+    lambda_invocations++;
+    starting_workers.push_back( steady_clock::now() );
+    invocation_window = min( invocation_window + 1, max_window );
+    return;
+  }
+
+  if ( status == "429" or status.substr( 0, 1 ) == "5" ) {
+    /* we're going too fast; try this one again in a bit */
+    if ( status == "429" ) {
+      throttled_invocations++;
+    }
+
+    pending_invocations++;
+    invocation_window = max<size_t>( invocation_window / 2, 1 );
+    invocation_backoff_until = steady_clock::now() + INVOCATION_BACKOFF;
+    return;
+  }
+
+  /* retrying won't help, but don't keep hammering the endpoint either */
+  invocation_backoff_until = steady_clock::now() + INVOCATION_BACKOFF;
+
+  cerr << "\u2192 Lambda invocation failed (" << response.first_line()
+       << "): " << response.body() << endl;
+}
+
+void LambdaMaster::handle_lambda_connection_close( const size_t index )
+{
+  auto& connection = lambda_connections[index];
+
+  if ( connection.closed ) {
+    return;
+  }
+
+  /* we can't tell whether these went through; asking again is cheaper than
+     missing workers. The client is dropped on the next dispatch, outside of
+     its own callbacks. */
+  connection.closed = true;
+  pending_invocations += connection.in_flight;
+  invocations_in_flight -= connection.in_flight;
+  connection.in_flight = 0;
+}
@@ -2,6 +2,7 @@
 
 #include <filesystem>
 #include <fstream>
+#include <list>
 #include <map>
 #include <memory>
 #include <optional>
@@ -14,6 +15,8 @@
 #include "common/lambda.hh"
 #include "common/stats.hh"
 #include "common/tile_helper.hh"
+#include "master/outstanding.hh"
+#include "master/shards.hh"
 #include "messages/message.hh"
 #include "net/address.hh"
 #include "net/aws.hh"
@@ -22,7 +25,10 @@
 #include "net/session.hh"
 #include "r2t2.pb.h"
 #include "schedulers/scheduler.hh"
-#include "storage/backend_s3.hh"
+#include "storage/backend.hh"
+#include "storage/object_cache.hh"
+#include "util/child_process.hh"
+#include "util/column_log.hh"
 #include "util/eventfd.hh"
 #include "util/signalfd.hh"
 #include "util/temp_dir.hh"
@@ -36,7 +42,34 @@ namespace r2t2 {
 
 constexpr std::chrono::milliseconds STATUS_PRINT_INTERVAL { 1'000 };
 constexpr std::chrono::milliseconds RESCHEDULE_INTERVAL { 1'000 };
-constexpr std::chrono::milliseconds WORKER_INVOCATION_INTERVAL { 5'000 };
+constexpr std::chrono::milliseconds WORKER_INVOCATION_INTERVAL { 100 };
+constexpr std::chrono::milliseconds AUTOSCALE_INTERVAL { 10'000 };
+
+constexpr double LAMBDA_UNIT_COST = 0.00004897; /* $/lambda/sec */
+
+/* the memory our Lambda function is created with (create-function.py) */
+constexpr uint64_t LAMBDA_MEMORY_SIZE = 3008ull * 1024 * 1024;
+
+/* the shares of a worker's memory that its queued work may take up; the
+   rest is for the scene and the bags in flight */
+constexpr double TRACER_WORK_SHARE = 0.04;
+constexpr double ACCUMULATOR_WORK_SHARE = 0.1;
+
+/* a worker above this share of its memory gets no more work */
+constexpr double MEMORY_HIGH_WATERMARK = 0.9;
+
+/* the default concurrency limit of an AWS account */
+constexpr size_t LAMBDA_CONCURRENCY_LIMIT = 1000;
+
+/* persistent connections to the Lambda endpoint, and the invocations we
+   pipeline on each */
+constexpr size_t LAMBDA_CONNECTIONS = 8;
+constexpr size_t INVOCATION_PIPELINE_DEPTH = 16;
+
+/* how long we hold off after Lambda throttles us, and how long we wait for
+   an invoked worker to show up before we count it as lost */
+constexpr std::chrono::milliseconds INVOCATION_BACKOFF { 500 };
+constexpr std::chrono::seconds WORKER_STARTUP_TIMEOUT { 30 };
 
 struct MasterConfiguration
 {
@@ -59,6 +92,25 @@ struct MasterConfiguration
 
   std::vector<std::string> memcached_servers;
   std::vector<std::pair<std::string, uint32_t>> engines;
+
+  /* with either of these, the master resizes the pool as it goes */
+  std::optional<std::chrono::seconds> deadline;
+  std::optional<double> cost_budget;
+  double worker_cost; /* $ per worker per second */
+
+  /* a worker's work budget is its share of memory, by role; the memory
+     size is used for workers that don't report theirs */
+  uint64_t worker_memory;
+  double tracer_work_share;
+  double accumulator_work_share;
+
+  /* threads that decode worker messages; none means the event loop does */
+  size_t message_shards;
+
+  /* the most Lambda workers we run at once, and the connections we invoke
+     them over */
+  size_t lambda_concurrency;
+  size_t lambda_connections;
 };
 
 class LambdaMaster
@@ -117,14 +169,70 @@ private:
   const std::string public_address;
   const std::string storage_backend_uri;
   const Storage storage_backend_info;
-  S3StorageBackend scene_storage_backend;
-  S3StorageBackend job_storage_backend;
+  std::unique_ptr<StorageBackend> scene_storage_backend;
+  std::unique_ptr<StorageBackend> job_storage_backend;
   const std::string aws_region;
   const Address aws_address;
   const std::string lambda_function_name {
     safe_getenv_or( "R2T2_LAMBDA_FUNCTION", "r2t2-lambda-function" )
   };
 
+  ////////////////////////////////////////////////////////////////////////////
+  // Engines                                                                //
+  ////////////////////////////////////////////////////////////////////////////
+
+  /* instead of Lambda, workers can run on our own machines (--engine):
+     "local" starts r2t2-lambda-worker processes on this machine, while
+     "host:port" asks the lambda-server running there to start them */
+  struct Engine
+  {
+    std::string name;
+    uint32_t max_jobs;
+    uint32_t running_jobs { 0 };
+    std::optional<Address> server_address {};
+
+    Engine( const std::string& name_, const uint32_t max_jobs_ );
+  };
+
+  struct LocalWorker
+  {
+    size_t engine_index;
+    ChildProcess process;
+  };
+
+  std::vector<Engine> engines {};
+  size_t next_engine { 0 };
+
+  /* a local worker that has started (and preloaded the base objects) and
+     is waiting for its invocation on `control`; there's one for each free
+     slot of a local engine, as with lambda-server's pool */
+  struct WarmLocalWorker
+  {
+    size_t engine_index;
+    ChildProcess process;
+    FileDescriptor control;
+  };
+
+  std::string local_worker_program {};
+  std::vector<std::string> local_worker_command {};
+  protobuf::InvocationPayload local_invocation {};
+  std::list<LocalWorker> local_workers {};
+  std::list<WarmLocalWorker> warm_local_workers {};
+
+  void refill_local_pool( const size_t engine_index );
+
+  void setup_engines( const protobuf::InvocationPayload& payload );
+
+  /* returns the number of workers that were actually launched */
+  size_t invoke_workers_on_engines( const size_t n );
+
+  void launch_local_worker( const size_t engine_index );
+  void launch_remote_worker( const size_t engine_index );
+
+  /* reaps local workers that exited and frees their engine slots; warm
+     ones that exit before they're used aren't started again */
+  void handle_local_worker_exits();
+
   ////////////////////////////////////////////////////////////////////////////
   // Workers                                                                //
   ////////////////////////////////////////////////////////////////////////////
@@ -134,6 +242,7 @@ private:
     enum class State
     {
       Active,
+      Swapping,
       FinishingUp,
       Terminating,
       Terminated
@@ -168,7 +277,16 @@ private:
 
     TileId tile_id {};
 
-    std::set<RayBagInfo> outstanding_ray_bags {};
+    /* what the worker last told us about its memory, in bytes */
+    uint64_t memory_usage { 0 };
+    uint64_t memory_limit { 0 };
+    uint64_t queued_bytes { 0 };
+
+    /* camera rays we've asked for since then */
+    uint64_t camera_bytes { 0 };
+
+    /* the bags this worker has yet to pick up, and when we assigned them */
+    OutstandingBags outstanding_ray_bags {};
     size_t outstanding_bytes { 0 };
 
     struct
@@ -188,12 +306,17 @@ private:
              - rays.enqueued - rays.accumulated;
     }
 
+    uint64_t active_bytes() const
+    {
+      return queued_bytes + outstanding_bytes + camera_bytes;
+    }
+
     // Statistics
     bool is_logged { true };
     WorkerStats stats {};
     WorkerStats last_stats {};
 
-    protobuf::RayBags to_be_assigned {};
+    RayBagBatch to_be_assigned {};
     bool marked_free { false };
 
     std::string to_string() const;
@@ -204,6 +327,9 @@ private:
 
   std::deque<Worker> workers {};
   const uint32_t max_workers;
+
+  /* the number of tracers we're aiming for, up to max_workers */
+  uint32_t target_workers { max_workers };
   const uint32_t ray_generators;
   uint32_t finished_ray_generators { 0 };
   uint32_t accumulators;
@@ -223,6 +349,9 @@ private:
     TreeletId id;
     size_t pending_workers { 0 };
     std::set<WorkerId> workers {};
+
+    /* how long its bags waited in the queue before being assigned (us) */
+    Histogram queue_wait {};
     std::pair<bool, TreeletStats> last_stats { true, {} };
 
     Treelet( const TreeletId treelet_id )
@@ -238,19 +367,77 @@ private:
   // Scheduler                                                              //
   ////////////////////////////////////////////////////////////////////////////
 
-  /* this function is periodically called; it calls the scheduler,
-     and if a new schedule is available, it executes it */
+  /* this function is periodically called; it asks the scheduler for a
+     placement plan, and if there's one, it executes it */
   void handle_reschedule();
 
   void handle_worker_invocation();
 
-  void execute_schedule( const Schedule& schedule );
+  void execute_plan( const Plan& plan );
 
   /* requests invoking n workers */
   void invoke_workers( const size_t n );
 
+  ////////////////////////////////////////////////////////////////////////////
+  // Lambda Invocations                                                     //
+  ////////////////////////////////////////////////////////////////////////////
+
+  /* invocations are pipelined over a few persistent HTTPS connections to
+     the Lambda endpoint. The workers we've asked for are kept under the
+     concurrency limit, and the invocations in flight under a window that
+     halves whenever Lambda throttles us. */
+  struct LambdaConnection
+  {
+    std::unique_ptr<HTTPClient<SSLSession>> client {};
+    size_t in_flight { 0 };
+    bool closed { false };
+  };
+
+  std::vector<LambdaConnection> lambda_connections {};
+  size_t next_lambda_connection { 0 };
+
+  size_t pending_invocations { 0 };
+  size_t invocations_in_flight { 0 };
+  size_t invocation_window { 0 };
+  steady_clock::time_point invocation_backoff_until {};
+
+  /* when each invoked worker that is yet to connect was accepted */
+  std::deque<steady_clock::time_point> starting_workers {};
+
+  uint64_t lambda_invocations { 0 };
+  uint64_t throttled_invocations { 0 };
+
+  /* workers we've asked for that haven't connected yet */
+  size_t requested_workers();
+
+  /* sends as many pending invocations as the limits allow */
+  void dispatch_invocations();
+
+  void open_lambda_connection( const size_t index );
+  void handle_invocation_response( const size_t index,
+                                   const HTTPResponse& response );
+  void handle_lambda_connection_close( const size_t index );
+
+  /* grows or shrinks the pool to meet the deadline or the budget */
+  void handle_autoscale();
+
+  struct
+  {
+    steady_clock::time_point last_tick {};
+    steady_clock::time_point last_change {};
+    uint64_t last_finished_paths { 0 };
+
+    double path_rate { 0 };      /* EWMA of finished paths per second */
+    double worker_seconds { 0 }; /* what we've been billed for so far */
+
+    /* the pool before the last change, to see what the change bought */
+    uint32_t previous_workers { 0 };
+    double previous_rate { 0 };
+  } autoscale {};
+
   std::unique_ptr<Scheduler> scheduler;
-  std::deque<TreeletId> treelets_to_spawn {};
+  /* the treelets each worker we're yet to start will get */
+  std::deque<std::vector<TreeletId>> treelets_to_spawn {};
   std::string invocation_payload {};
 
   ////////////////////////////////////////////////////////////////////////////
@@ -263,9 +450,24 @@ private:
   void assign_base_objects( Worker& worker );
   void assign_treelet( Worker& worker, Treelet& treelet );
 
+  /* moves a live worker over to `treelet`, instead of replacing it; with
+     `keep_current`, the worker takes it on next to the treelets it has */
+  void swap_treelet( Worker& worker,
+                     Treelet& treelet,
+                     const bool keep_current = false );
+
   std::map<pbrt::ObjectType, std::string> alternative_object_names {};
   std::set<TreeletId> unassigned_treelets {};
 
+  /* reads the scene's compression manifest, if it has one */
+  void load_compression_manifest( const std::string& scene_path );
+
+  /* objects that workers should fetch LZ4-compressed */
+  std::set<pbrt::ObjectKey> compressed_objects {};
+
+  /* uncompressed / compressed size, by object type */
+  std::map<std::string, double> compression_ratios {};
+
   ////////////////////////////////////////////////////////////////////////////
   // Communication                                                          //
   ////////////////////////////////////////////////////////////////////////////
@@ -273,24 +475,61 @@ private:
   /*** Messages *************************************************************/
 
   /* processes incoming messages; called by handleMessages */
-  void process_message( const WorkerId worker_id,
-                        const meow::Message& message );
+  void process_message( const DecodedMessage& decoded );
 
-  /*** Ray Bags *************************************************************/
+  /* called once a worker's connection is closed */
+  void handle_worker_close( const WorkerId worker_id );
+
+  /* with --shards, messages are decoded off the event loop thread */
+  std::unique_ptr<MessageShards> message_shards {};
+  std::vector<DecodedMessage> decoded_messages {};
+
+  /* without shards, every message is decoded into this one */
+  DecodedMessage inline_message {};
+  void handle_decoded_messages();
+
+  uint64_t worker_messages { 0 };
 
-  std::pair<bool, bool> assign_work( Worker& worker );
+  /*** Ray Bags *************************************************************/
 
+  /* hands out queued bags to the free workers, least loaded first */
   void handle_queued_ray_bags();
 
+  /* whether the worker's queued work is below its share of memory */
+  bool has_room( const Worker& worker ) const;
+
+  void assign_bag( Worker& worker, const RayBagInfo& info );
+  void flush_assignments();
+
+  /* the free tracers of each treelet, filled and emptied on every call */
+  std::vector<std::vector<WorkerId>> ready_workers {};
+
+  /* the workers with assignments that have yet to be sent */
+  std::vector<WorkerId> dirty_workers {};
+
+  /* time spent handing out bags since the last reschedule tick, and the
+     master's total for the last tick (dispatching and rescheduling) */
+  steady_clock::duration dispatch_time {};
+  steady_clock::duration tick_time {};
+
   /* NOTE: in the following group of queues, the first N queues are for
   treelets, and the next M are for tiles (for accumulation) */
 
+  struct QueuedBag
+  {
+    RayBagInfo info {};
+    steady_clock::time_point queued_at { steady_clock::now() };
+  };
+
   /* ray bags that are going to be assigned to workers */
-  std::vector<std::queue<RayBagInfo>> queued_ray_bags {};
+  std::vector<std::queue<QueuedBag>> queued_ray_bags {};
   size_t queued_ray_bags_count { 0 };
 
   /* ray bags that there are no workers for them */
-  std::vector<std::queue<RayBagInfo>> pending_ray_bags {};
+  std::vector<std::queue<QueuedBag>> pending_ray_bags {};
+
+  /* hands the bag at the front of the queue to the worker */
+  void assign_queued_bag( Worker& worker, std::queue<QueuedBag>& queue );
 
   /* sample bags */
   std::vector<RayBagInfo> sample_bags {};
@@ -298,25 +537,57 @@ private:
   void move_from_pending_to_queued( const TreeletId treelet_id );
   void move_from_queued_to_pending( const TreeletId treelet_id );
 
+  /* queues a bag for its treelet, or keeps it aside if nobody has that */
+  void queue_ray_bag( const RayBagInfo& info );
+
+  /* lets go of a tracer that went away while it held no rays, and asks for
+     a worker to replace it if its treelets need one */
+  void recover_worker( Worker& worker );
+
   ////////////////////////////////////////////////////////////////////////////
   // Stats                                                                  //
   ////////////////////////////////////////////////////////////////////////////
 
   WorkerStats aggregated_stats {};
+
+  /* where the rays go when they leave a treelet, built from bag metadata */
+  TransitionMatrix treelet_transitions {};
   pbrt::AccumulatedStats pbrt_stats {};
   double estimated_cost { 0 };
 
+  /* time from invocation to the first ray, as reported by the workers */
+  struct
+  {
+    size_t count { 0 };
+    std::chrono::microseconds total { 0 };
+    std::chrono::microseconds max { 0 };
+  } first_ray_latency {};
+
+  /* workers' on-disk scene object caches, summed up */
+  ObjectCache::Stats scene_cache_stats {};
+
+  /* the stages of the bags' trips the workers time, for the whole job and
+     since the last status line; and how long bags wait for a worker */
+  BagLatencies bag_latencies {};
+  BagLatencies recent_bag_latencies {};
+  Histogram recent_queue_wait {};
+
+  /* the workers' transfer agents, from request to result (us) */
+  Histogram transfer_latency {};
+
   /*** Outputting stats *****************************************************/
 
   void record_enqueue( const WorkerId worker_id, const RayBagInfo& info );
   void record_assign( const WorkerId worker_id, const RayBagInfo& info );
   void record_dequeue( const WorkerId worker_id, const RayBagInfo& info );
 
-  /* object for writing worker & treelet stats, and allocations */
-  std::ofstream ws_stream {};
-  std::ofstream tl_stream {};
-  std::ofstream alloc_stream {};
-  std::ofstream summary_stream {};
+  /* columnar logs of worker & treelet stats, and allocations; see
+     r2t2-stats-to-csv for turning them into CSV */
+  column_log::Writer ws_log {};
+  column_log::Writer tl_log {};
+  column_log::Writer alloc_log {};
+  column_log::Writer tr_log {};
+  column_log::Writer summary_log {};
 
   /* write worker stats periodically */
   void handle_worker_stats();
@@ -324,6 +595,9 @@ private:
   /* prints the status message every second */
   void handle_status_message();
 
+  /* fetches the workers' --log-rays/--log-bags traces at the end */
+  void download_trace_chunks();
+
   /*** Timepoints ***********************************************************/
 
   const steady_clock::time_point start_time { steady_clock::now() };
@@ -343,14 +617,8 @@ private:
   struct SceneData
   {
   public:
-    static inline const std::vector<pbrt::ObjectType> base_object_types {
-      pbrt::ObjectType::Manifest,
-      pbrt::ObjectType::Scene,
-      pbrt::ObjectType::Camera,
-      pbrt::ObjectType::Lights,
-      pbrt::ObjectType::AreaLights,
-      pbrt::ObjectType::Sampler
-    };
+    static inline const std::vector<pbrt::ObjectType>& base_object_types
+      = BASE_OBJECT_TYPES;
     pbrt::scene::Base base {};
 
     pbrt::Bounds2i sample_bounds {};
@@ -400,16 +668,18 @@ private:
   meow::Client<TCPSession>::RuleCategories worker_rule_categories;
 
   TCPSocket listener_socket {};
-  SignalMask signals { SIGHUP, SIGTERM, SIGQUIT, SIGINT };
+  SignalMask signals { SIGHUP, SIGTERM, SIGQUIT, SIGINT, SIGCHLD };
   SignalFD signal_fd { signals };
 
   void handle_signal( const signalfd_siginfo& sig );
 
   SSLContext ssl_context {};
-  std::list<HTTPClient<SSLSession>> https_clients {};
-  std::list<decltype( https_clients )::iterator> finished_https_clients {};
   HTTPClient<SSLSession>::RuleCategories https_rule_categories;
 
+  std::list<HTTPClient<TCPSession>> engine_clients {};
+  std::list<decltype( engine_clients )::iterator> finished_engine_clients {};
+  HTTPClient<TCPSession>::RuleCategories engine_rule_categories;
+
   /* Timers */
   TimerFD status_print_timer { STATUS_PRINT_INTERVAL };
   TimerFD worker_invocation_timer { WORKER_INVOCATION_INTERVAL,
@@ -418,6 +688,7 @@ private:
                              std::chrono::milliseconds { 500 } };
   TimerFD worker_stats_write_timer { std::chrono::seconds { 1 },
                                      std::chrono::milliseconds { 1 } };
+  TimerFD autoscale_timer { AUTOSCALE_INTERVAL };
 
   TimerFD job_exit_timer { std::chrono::minutes { 15 } };
   TimerFD job_timeout_timer {};
@@ -1,4 +1,5 @@
 #include <cstdlib>
+#include <ctime>
 #include <iomanip>
 
 #include "lambda-master.hh"
@@ -8,6 +9,13 @@ using namespace std;
 using namespace chrono;
 using namespace r2t2;
 
+static double cpu_seconds( const clockid_t clock )
+{
+  timespec ts;
+  clock_gettime( clock, &ts );
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
 static const bool R2T2_POWERLINE = ( getenv( "R2T2_POWERLINE" ) != nullptr );
 
 void LambdaMaster::record_enqueue( const WorkerId worker_id,
@@ -31,6 +39,11 @@ void LambdaMaster::record_enqueue( const WorkerId worker_id,
     worker.stats.enqueued.bytes += info.bag_size;
     worker.stats.enqueued.count++;
 
+    if ( info.source_treelet_id ) {
+      treelet_transitions.add(
+        *info.source_treelet_id, info.treelet_id, info.bag_size );
+    }
+
     treelets[info.treelet_id].last_stats.first = true;
     treelet_stats[info.treelet_id].enqueued.rays += info.ray_count;
     treelet_stats[info.treelet_id].enqueued.bytes += info.bag_size;
@@ -48,7 +61,7 @@ void LambdaMaster::record_assign( const WorkerId worker_id,
   auto& worker = workers.at( worker_id );
   worker.rays.dequeued += info.ray_count;
 
-  worker.outstanding_ray_bags.insert( info );
+  worker.outstanding_ray_bags.insert( info, steady_clock::now() );
   worker.outstanding_bytes += info.bag_size;
 
   worker.stats.assigned.rays += info.ray_count;
@@ -68,6 +81,9 @@ void LambdaMaster::record_dequeue( const WorkerId worker_id,
   worker.outstanding_ray_bags.erase( info );
   worker.outstanding_bytes -= info.bag_size;
 
+  /* the bag is in the worker's queues now; its next report has the rest */
+  worker.queued_bytes += info.bag_size;
+
   if ( info.sample_bag ) {
     worker.rays.accumulated += info.ray_count;
   } else {
@@ -98,6 +114,8 @@ void LambdaMaster::handle_worker_stats()
 
   constexpr double ALPHA = 2.0 / ( 7 + 1 );
 
+  treelet_transitions.decay( 1 - ALPHA );
+
   for ( size_t treelet_id = 0; treelet_id < treelets.size(); treelet_id++ ) {
     auto& treelet = treelets[treelet_id];
     auto& stats = treelet_stats[treelet_id];
@@ -121,16 +139,17 @@ void LambdaMaster::handle_worker_stats()
       = ( 1 - ALPHA ) * stats.dequeue_rate + ALPHA * diff.dequeued.bytes;
 
     if ( config.write_stat_logs ) {
-      /* timestamp,treeletId,raysEnqueued,raysDequeued,bytesEnqueued,
-         bytesDequeued,bagsEnqueued,bagsDequeued,enqueueRate,dequeueRate,
-         cpuUsage */
-      tl_stream << t.count() << ',' << treelet_id << ',' << fixed
-                << diff.enqueued.rays << ',' << diff.dequeued.rays << ','
-                << diff.enqueued.bytes << ',' << diff.dequeued.bytes << ','
-                << diff.enqueued.count << ',' << diff.dequeued.count << ','
-                << stats.enqueue_rate << ',' << stats.dequeue_rate << ','
-                << fixed << setprecision( 2 ) << ( 100 * stats.cpu_usage )
-                << '\n';
+      tl_log.append( t.count(),
+                     treelet_id,
+                     diff.enqueued.rays,
+                     diff.dequeued.rays,
+                     diff.enqueued.bytes,
+                     diff.dequeued.bytes,
+                     diff.enqueued.count,
+                     diff.dequeued.count,
+                     stats.enqueue_rate,
+                     stats.dequeue_rate,
+                     100 * stats.cpu_usage );
     }
   }
 
@@ -138,6 +157,10 @@ void LambdaMaster::handle_worker_stats()
     return;
   }
 
+  for ( const auto& [src, dst, weight] : treelet_transitions.entries() ) {
+    tr_log.append( t.count(), src, dst, weight );
+  }
+
   for ( Worker& worker : workers ) {
     if ( !worker.is_logged )
       continue;
@@ -148,19 +171,22 @@ void LambdaMaster::handle_worker_stats()
     const auto diff = worker.stats - worker.last_stats;
     worker.last_stats = worker.stats;
 
-    /* timestamp,workerId,pathsFinished,raysEnqueued,raysAssigned,raysDequeued,
-       bytesEnqueued,bytesAssigned,bytesDequeued,bagsEnqueued,bagsAssigned,
-       bagsDequeued,numSamples,bytesSamples,bagsSamples,cpuUsage */
-
-    ws_stream << t.count() << ',' << worker.id << ',' << fixed
-              << diff.finished_paths << ',' << diff.enqueued.rays << ','
-              << diff.assigned.rays << ',' << diff.dequeued.rays << ','
-              << diff.enqueued.bytes << ',' << diff.assigned.bytes << ','
-              << diff.dequeued.bytes << ',' << diff.enqueued.count << ','
-              << diff.assigned.count << ',' << diff.dequeued.count << ','
-              << diff.samples.rays << ',' << diff.samples.bytes << ','
-              << diff.samples.count << ',' << fixed << setprecision( 2 )
-              << ( 100 * diff.cpu_usage ) << '\n';
+    ws_log.append( t.count(),
+                   worker.id,
+                   diff.finished_paths,
+                   diff.enqueued.rays,
+                   diff.assigned.rays,
+                   diff.dequeued.rays,
+                   diff.enqueued.bytes,
+                   diff.assigned.bytes,
+                   diff.dequeued.bytes,
+                   diff.enqueued.count,
+                   diff.assigned.count,
+                   diff.dequeued.count,
+                   diff.samples.rays,
+                   diff.samples.bytes,
+                   diff.samples.count,
+                   100 * diff.cpu_usage );
 
     estimated_cost += T;
   }
@@ -240,6 +266,45 @@ protobuf::JobSummary LambdaMaster::get_job_summary() const
 
   proto.set_num_accumulators( accumulators );
 
+  if ( first_ray_latency.count ) {
+    proto.set_first_ray_time( first_ray_latency.total.count() / 1e6
+                              / first_ray_latency.count );
+    proto.set_max_first_ray_time( first_ray_latency.max.count() / 1e6 );
+  }
+
+  proto.set_cache_hits( scene_cache_stats.hits );
+  proto.set_cache_misses( scene_cache_stats.misses );
+  proto.set_cache_bytes_saved( scene_cache_stats.bytes_saved );
+
+  for ( const auto& [type, ratio] : compression_ratios ) {
+    ( *proto.mutable_compression_ratios() )[type] = ratio;
+  }
+
+  proto.set_lambda_invocations( lambda_invocations );
+  proto.set_throttled_invocations( throttled_invocations );
+
+  for ( const auto& histogram : bag_latencies ) {
+    *proto.add_bag_latencies() = to_protobuf( histogram );
+  }
+
+  Histogram queue_wait;
+
+  for ( const auto& treelet : treelets ) {
+    if ( treelet.queue_wait.count() ) {
+      queue_wait.merge( treelet.queue_wait );
+      ( *proto.mutable_treelet_queue_waits() )[treelet.id]
+        = to_protobuf( treelet.queue_wait );
+    }
+  }
+
+  *proto.mutable_bag_queue_wait() = to_protobuf( queue_wait );
+  *proto.mutable_transfer_latency() = to_protobuf( transfer_latency );
+
+  /* this runs on the event loop thread */
+  proto.set_worker_messages( worker_messages );
+  proto.set_master_cpu_time( cpu_seconds( CLOCK_PROCESS_CPUTIME_ID ) );
+  proto.set_event_loop_cpu_time( cpu_seconds( CLOCK_THREAD_CPUTIME_ID ) );
+
   return proto;
 }
 
@@ -482,6 +547,99 @@ void LambdaMaster::print_job_summary() const
   print_title( "  Ray tracing" );
   cout << Value<double>( proto.tracing_time() ) << " seconds" << endl;
 
+  if ( proto.first_ray_time() > 0 ) {
+    print_title( "Invoke to first ray" );
+    cout << Value<double>( proto.first_ray_time() ) << " seconds (max "
+         << proto.max_first_ray_time() << ")" << endl;
+  }
+
+  if ( proto.cache_hits() + proto.cache_misses() > 0 ) {
+    const auto lookups = proto.cache_hits() + proto.cache_misses();
+
+    print_title( "Scene cache hits" );
+    cout << Value<double>( percent( proto.cache_hits(), lookups ) ) << "% ("
+         << format_bytes( proto.cache_bytes_saved() ) << " saved)" << endl;
+  }
+
+  if ( proto.lambda_invocations() > 0 ) {
+    print_title( "Lambda invocations" );
+    cout << Value<uint64_t>( proto.lambda_invocations() ) << " ("
+         << proto.throttled_invocations() << " throttled)" << endl;
+  }
+
+  if ( proto.bag_queue_wait().count() > 0 ) {
+    auto print_latency = [&]( const string& title,
+                              const protobuf::HistogramUInt64& histogram ) {
+      const auto h = from_protobuf( histogram );
+
+      if ( h.count() == 0 ) {
+        return;
+      }
+
+      auto us = []( const uint64_t n ) {
+        return format_duration( microseconds( n ) );
+      };
+
+      print_title( "  " + title );
+      cout << Value<string>( us( h.quantile( 0.5 ) ) ) << ", "
+           << us( h.quantile( 0.99 ) ) << ", " << us( h.max() ) << endl;
+    };
+
+    print_title( "Bag latencies" );
+    cout << "p50, p99, max" << endl;
+
+    /* in the order a bag goes through them */
+    for ( size_t i = 0; i < static_cast<size_t>( proto.bag_latencies_size() );
+          i++ ) {
+      const auto stage = static_cast<BagStage>( i );
+
+      if ( stage == BagStage::Download ) {
+        print_latency( "queue", proto.bag_queue_wait() );
+      }
+
+      print_latency( stage_name( stage ), proto.bag_latencies( i ) );
+    }
+  }
+
+  if ( proto.transfer_latency().count() > 0 ) {
+    const auto h = from_protobuf( proto.transfer_latency() );
+
+    auto us = []( const uint64_t n ) {
+      return format_duration( microseconds( n ) );
+    };
+
+    print_title( "Transfer latency" );
+    cout << Value<string>( us( h.quantile( 0.5 ) ) ) << " p50, "
+         << us( h.quantile( 0.99 ) ) << " p99, " << us( h.max() ) << " max"
+         << endl;
+  }
+
+  if ( proto.worker_messages() > 0 ) {
+    /* CPU seconds per 1k messages = cores busy per 1k messages/s */
+    const double per_kmsg = 1000.0 * 100 / proto.worker_messages();
+
+    print_title( "Master CPU" );
+    cout << Value<double>( proto.master_cpu_time() * per_kmsg )
+         << "% of a core per 1k messages/s ("
+         << proto.event_loop_cpu_time() * per_kmsg << "% on the event loop)"
+         << endl;
+  }
+
+  if ( not proto.compression_ratios().empty() ) {
+    print_title( "Compression ratio" );
+
+    /* protobuf maps are unordered */
+    const map<string, double> ratios { proto.compression_ratios().begin(),
+                                       proto.compression_ratios().end() };
+
+    for ( auto it = ratios.begin(); it != ratios.end(); it++ ) {
+      cout << ( it == ratios.begin() ? "" : ", " ) << it->first << " "
+           << Value<double>( it->second ) << "x";
+    }
+
+    cout << endl;
+  }
+
   print_title( "Estimated CPU-seconds" );
   cout << Value<double>( proto.estimated_cost() ) << endl;
 }
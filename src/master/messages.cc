@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <chrono>
 #include <typeinfo>
 
@@ -12,9 +13,12 @@ using namespace meow;
 
 using OpCode = Message::OpCode;
 
-void LambdaMaster::process_message( const uint64_t worker_id,
-                                    const Message& message )
+void LambdaMaster::process_message( const DecodedMessage& decoded )
 {
+  const WorkerId worker_id = decoded.worker_id;
+  const Message& message = *decoded.message;
+  worker_messages++;
+
 #ifndef NDEBUG
   cerr << "\u2190 " << message.info() << " from worker " << worker_id << endl;
 #endif
@@ -40,15 +44,22 @@ void LambdaMaster::process_message( const uint64_t worker_id,
 
       break;
 
+    case OpCode::SwapTreelet:
+      /* unless it was told to finish up in the meantime */
+      if ( worker.state == Worker::State::Swapping ) {
+        worker.state = Worker::State::Active;
+        free_workers.push_back( worker_id );
+      }
+
+      break;
+
     case OpCode::RayBagEnqueued: {
-      protobuf::RayBags proto;
-      protoutil::from_string( message.payload(), proto );
+      const RayBagBatch& bags = decoded.ray_bags;
 
-      worker.rays.generated = proto.rays_generated();
-      worker.rays.terminated = proto.rays_terminated();
+      worker.rays.generated = bags.rays_generated;
+      worker.rays.terminated = bags.rays_terminated;
 
-      for ( const auto& item : proto.items() ) {
-        const RayBagInfo info = from_protobuf( item );
+      for ( const RayBagInfo& info : bags.items ) {
         record_enqueue( worker_id, info );
 
         if ( info.sample_bag ) {
@@ -57,17 +68,12 @@ void LambdaMaster::process_message( const uint64_t worker_id,
             sample_bags.push_back( info );
             continue;
           } else {
-            queued_ray_bags[treelet_count + info.tile_id].push( info );
+            queued_ray_bags[treelet_count + info.tile_id].push( { info } );
             queued_ray_bags_count++;
           }
         } else {
           // normal ray bag
-          if ( unassigned_treelets.count( info.treelet_id ) == 0 ) {
-            queued_ray_bags[info.treelet_id].push( info );
-            queued_ray_bags_count++;
-          } else {
-            pending_ray_bags[info.treelet_id].push( info );
-          }
+          queue_ray_bag( info );
         }
       }
 
@@ -80,9 +86,7 @@ void LambdaMaster::process_message( const uint64_t worker_id,
           worker.client.push_request( { 0, OpCode::FinishUp, "" } );
           worker.state = Worker::State::FinishingUp;
         }
-      } else if ( worker.active_rays() < ( worker.role == Worker::Role::Tracer
-                                             ? WORKER_MAX_ACTIVE_RAYS
-                                             : WORKER_MAX_ACTIVE_SAMPLES ) ) {
+      } else if ( has_room( worker ) ) {
         free_workers.push_back( worker_id );
       }
 
@@ -90,19 +94,17 @@ void LambdaMaster::process_message( const uint64_t worker_id,
     }
 
     case OpCode::RayBagDequeued: {
-      protobuf::RayBags proto;
-      protoutil::from_string( message.payload(), proto );
+      const RayBagBatch& bags = decoded.ray_bags;
 
-      worker.rays.generated = proto.rays_generated();
-      worker.rays.terminated = proto.rays_terminated();
+      worker.rays.generated = bags.rays_generated;
+      worker.rays.terminated = bags.rays_terminated;
 
-      for ( const auto& item : proto.items() ) {
-        const RayBagInfo info = from_protobuf( item );
+      for ( const RayBagInfo& info : bags.items ) {
         record_dequeue( worker_id, info );
       }
 
       if ( worker.role == Worker::Role::Accumulator ) {
-        if ( worker.active_rays() < WORKER_MAX_ACTIVE_SAMPLES ) {
+        if ( has_room( worker ) ) {
           free_workers.push_back( worker_id );
         }
       }
@@ -111,28 +113,59 @@ void LambdaMaster::process_message( const uint64_t worker_id,
     }
 
     case OpCode::WorkerStats: {
-      protobuf::WorkerStats proto;
-      protoutil::from_string( message.payload(), proto );
+      const protobuf::WorkerStats& proto = *decoded.worker_stats;
 
       const WorkerStats stats = from_protobuf( proto );
 
       worker.stats.finished_paths += stats.finished_paths;
       worker.stats.cpu_usage = stats.cpu_usage;
 
+      worker.memory_usage = proto.memory_usage();
+      worker.memory_limit = proto.memory_limit();
+      worker.queued_bytes = proto.queued_bytes();
+      worker.camera_bytes = 0;
+
+      for ( int i = 0; i < proto.bag_latencies_size()
+                       and i < static_cast<int>( BAG_STAGE_COUNT );
+            i++ ) {
+        const auto histogram = from_protobuf( proto.bag_latencies( i ) );
+        bag_latencies[i].merge( histogram );
+        recent_bag_latencies[i].merge( histogram );
+      }
+
+      transfer_latency.merge( from_protobuf( proto.transfer_latency() ) );
+
+      /* it may have made room since it last asked for work */
+      if ( worker.role != Worker::Role::Generator and has_room( worker ) ) {
+        free_workers.push_back( worker_id );
+      }
+
       if ( not worker.treelets.empty()
            and ( initialized_workers
                  >= max_workers + ray_generators + accumulators ) ) {
-        const auto treelet_id = worker.treelets.back();
-        const double ALPHA
-          = 2.0 / ( 10 * treelets[treelet_id].workers.size() + 1 );
+        for ( const TreeletId treelet_id : worker.treelets ) {
+          const double ALPHA
+            = 2.0 / ( 10 * treelets[treelet_id].workers.size() + 1 );
 
-        auto& t_stats = treelet_stats[treelet_id];
-        t_stats.cpu_usage
-          = ( 1 - ALPHA ) * t_stats.cpu_usage + ALPHA * stats.cpu_usage;
+          auto& t_stats = treelet_stats[treelet_id];
+          t_stats.cpu_usage
+            = ( 1 - ALPHA ) * t_stats.cpu_usage + ALPHA * stats.cpu_usage;
+        }
       }
 
       aggregated_stats.finished_paths += stats.finished_paths;
 
+      if ( proto.first_ray_us() ) {
+        const microseconds latency { proto.first_ray_us() };
+        first_ray_latency.count++;
+        first_ray_latency.total += latency;
+        first_ray_latency.max = max( first_ray_latency.max, latency );
+      }
+
+      scene_cache_stats.hits += proto.cache_hits();
+      scene_cache_stats.misses += proto.cache_misses();
+      scene_cache_stats.bytes_saved += proto.cache_bytes_saved();
+
       break;
     }
 
@@ -148,7 +181,7 @@ void LambdaMaster::process_message( const uint64_t worker_id,
       pbrt::AccumulatedStats worker_pbrt_stats = from_protobuf( proto );
       pbrt_stats.Merge( worker_pbrt_stats );
 
-      if ( not worker.treelets.empty() ) {
+      if ( config.write_stat_logs and not worker.treelets.empty() ) {
         const auto treelet_id = worker.treelets.back();
         const string k[4] = { "Integrator/Calls to Trace",
                               "Integrator/Calls to Shade",
@@ -159,8 +192,8 @@ void LambdaMaster::process_message( const uint64_t worker_id,
           return worker_pbrt_stats.counters[k[i]];
         };
 
-        summary_stream << worker.id << ',' << treelet_id << ',' << g( 0 ) << ','
-                       << g( 1 ) << ',' << g( 2 ) << ',' << g( 3 ) << '\n';
+        summary_log.append(
+          worker.id, treelet_id, g( 0 ), g( 1 ), g( 2 ), g( 3 ) );
       }
 
       worker.client.push_request( { 0, OpCode::Bye, "" } );
@@ -172,3 +205,21 @@ void LambdaMaster::process_message( const uint64_t worker_id,
                            + to_string( to_underlying( message.opcode() ) ) );
   }
 }
+
+void LambdaMaster::handle_decoded_messages()
+{
+  decoded_messages.clear();
+  message_shards->pop( decoded_messages );
+
+  for ( auto& decoded : decoded_messages ) {
+    if ( decoded.error ) {
+      rethrow_exception( decoded.error );
+    }
+
+    if ( decoded.message ) {
+      process_message( decoded );
+    } else {
+      handle_worker_close( decoded.worker_id );
+    }
+  }
+}
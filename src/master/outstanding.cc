@@ -0,0 +1,142 @@
+#include "outstanding.hh"
+
+#include <stdexcept>
+
+using namespace std;
+using namespace r2t2;
+
+BagKey::BagKey( const RayBagInfo& info )
+  : high( ( info.worker_id << 32 ) | info.treelet_id )
+  , low( info.bag_id )
+{
+  if ( info.worker_id > UINT32_MAX ) {
+    throw runtime_error( "worker id doesn't fit in a bag key" );
+  }
+}
+
+size_t BagKeyHash::operator()( const BagKey& key ) const
+{
+  /* the finalizer of splitmix64 */
+  uint64_t x = key.high * 0x9e3779b97f4a7c15ull ^ key.low;
+  x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+  x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111ebull;
+  return x ^ ( x >> 31 );
+}
+
+size_t OutstandingBags::home( const BagKey& key ) const
+{
+  return BagKeyHash {}( key ) & ( slots_.size() - 1 );
+}
+
+size_t OutstandingBags::find_slot( const BagKey& key ) const
+{
+  /* the slot that has the key, or the empty one where it would go */
+  for ( size_t i = home( key );; i = ( i + 1 ) & ( slots_.size() - 1 ) ) {
+    if ( slots_[i] == NIL or BagKey { nodes_[slots_[i]].entry.info } == key ) {
+      return i;
+    }
+  }
+}
+
+void OutstandingBags::grow()
+{
+  vector<uint32_t> old_slots( max<size_t>( 16, 2 * slots_.size() ), NIL );
+  swap( slots_, old_slots );
+
+  for ( const uint32_t node : old_slots ) {
+    if ( node != NIL ) {
+      slots_[find_slot( nodes_[node].entry.info )] = node;
+    }
+  }
+}
+
+bool OutstandingBags::insert( const RayBagInfo& info,
+                              const time_point assigned_at )
+{
+  /* keeps the load factor under 3/4 */
+  if ( 4 * ( size_ + 1 ) > 3 * slots_.size() ) {
+    grow();
+  }
+
+  const size_t slot = find_slot( info );
+
+  if ( slots_[slot] != NIL ) {
+    return false;
+  }
+
+  uint32_t node;
+
+  if ( free_ != NIL ) {
+    node = free_;
+    free_ = nodes_[node].next;
+    nodes_[node] = { { info, assigned_at }, newest_, NIL };
+  } else {
+    node = static_cast<uint32_t>( nodes_.size() );
+    nodes_.push_back( { { info, assigned_at }, newest_, NIL } );
+  }
+
+  ( newest_ == NIL ? oldest_ : nodes_[newest_].next ) = node;
+  newest_ = node;
+
+  slots_[slot] = node;
+  size_++;
+
+  return true;
+}
+
+optional<OutstandingBags::Entry> OutstandingBags::erase(
+  const RayBagInfo& info )
+{
+  if ( size_ == 0 ) {
+    return nullopt;
+  }
+
+  size_t slot = find_slot( info );
+  const uint32_t node = slots_[slot];
+
+  if ( node == NIL ) {
+    return nullopt;
+  }
+
+  /* backward-shift deletion: move up the entries that probed past this
+     slot, so that lookups never need tombstones */
+  const size_t mask = slots_.size() - 1;
+  slots_[slot] = NIL;
+
+  for ( size_t i = ( slot + 1 ) & mask; slots_[i] != NIL;
+        i = ( i + 1 ) & mask ) {
+    const size_t h = home( nodes_[slots_[i]].entry.info );
+
+    /* can the entry at i move to the hole? only if its home isn't in
+       (slot, i] */
+    if ( ( ( i - h ) & mask ) >= ( ( i - slot ) & mask ) ) {
+      slots_[slot] = slots_[i];
+      slots_[i] = NIL;
+      slot = i;
+    }
+  }
+
+  Node& n = nodes_[node];
+  ( n.prev == NIL ? oldest_ : nodes_[n.prev].next ) = n.next;
+  ( n.next == NIL ? newest_ : nodes_[n.next].prev ) = n.prev;
+
+  Entry entry = n.entry;
+  n.next = free_;
+  free_ = node;
+  size_--;
+
+  return entry;
+}
+
+bool OutstandingBags::contains( const RayBagInfo& info ) const
+{
+  return size_ > 0 and slots_[find_slot( info )] != NIL;
+}
+
+void OutstandingBags::clear()
+{
+  nodes_.clear();
+  slots_.clear();
+  free_ = oldest_ = newest_ = NIL;
+  size_ = 0;
+}
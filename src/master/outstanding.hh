@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "common/lambda.hh"
+
+namespace r2t2 {
+
+/* what tells bags apart: (worker, treelet or tile, bag), packed in 128 bits;
+   worker ids have to fit in 32 */
+struct BagKey
+{
+  uint64_t high {};
+  uint64_t low {};
+
+  BagKey( const RayBagInfo& info );
+
+  bool operator==( const BagKey& other ) const
+  {
+    return high == other.high and low == other.low;
+  }
+};
+
+struct BagKeyHash
+{
+  size_t operator()( const BagKey& key ) const;
+};
+
+/* The bags a worker has been assigned but has yet to pick up. It's an open
+   addressing hash table over a slab of entries, which are also threaded on
+   a list from the oldest assignment to the newest. */
+class OutstandingBags
+{
+public:
+  using time_point = std::chrono::steady_clock::time_point;
+
+  struct Entry
+  {
+    RayBagInfo info;
+    time_point assigned_at;
+  };
+
+private:
+  static constexpr uint32_t NIL = UINT32_MAX;
+
+  struct Node
+  {
+    Entry entry;
+    uint32_t prev { NIL };
+    uint32_t next { NIL };
+  };
+
+  std::vector<Node> nodes_ {};
+  uint32_t free_ { NIL }; /* unused nodes, chained through `next` */
+
+  std::vector<uint32_t> slots_ {}; /* node indices; size is a power of 2 */
+  size_t size_ { 0 };
+
+  uint32_t oldest_ { NIL };
+  uint32_t newest_ { NIL };
+
+  size_t home( const BagKey& key ) const;
+  size_t find_slot( const BagKey& key ) const;
+  void grow();
+
+public:
+  class const_iterator
+  {
+  private:
+    const std::vector<Node>* nodes_;
+    uint32_t index_;
+
+  public:
+    const_iterator( const std::vector<Node>& nodes, const uint32_t index )
+      : nodes_( &nodes )
+      , index_( index )
+    {}
+
+    const Entry& operator*() const { return ( *nodes_ )[index_].entry; }
+    const Entry* operator->() const { return &( *nodes_ )[index_].entry; }
+
+    const_iterator& operator++()
+    {
+      index_ = ( *nodes_ )[index_].next;
+      return *this;
+    }
+
+    bool operator!=( const const_iterator& other ) const
+    {
+      return index_ != other.index_;
+    }
+  };
+
+  /* false if the bag was already there */
+  bool insert( const RayBagInfo& info, const time_point assigned_at );
+
+  /* returns the entry that was removed, if the bag was there */
+  std::optional<Entry> erase( const RayBagInfo& info );
+
+  bool contains( const RayBagInfo& info ) const;
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  void clear();
+
+  /* oldest assignment first */
+  const_iterator begin() const { return { nodes_, oldest_ }; }
+  const_iterator end() const { return { nodes_, NIL }; }
+};
+
+} // namespace r2t2
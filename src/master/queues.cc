@@ -1,127 +1,194 @@
+#include <algorithm>
+#include <chrono>
+#include <queue>
+
 #include "lambda-master.hh"
 #include "messages/utils.hh"
-#include "util/random.hh"
 
 using namespace std;
+using namespace chrono;
 using namespace r2t2;
 using namespace meow;
 
 using OpCode = Message::OpCode;
 
-pair<bool, bool> LambdaMaster::assign_work( Worker& worker )
+void LambdaMaster::assign_bag( Worker& worker, const RayBagInfo& info )
 {
-  /* return, if worker is not active anymore */
-  if ( worker.state != Worker::State::Active )
-    return { false, false };
+  if ( worker.to_be_assigned.empty() ) {
+    dirty_workers.push_back( worker.id );
+  }
 
-  /* if the worker's role is accumulator */
-  if ( worker.role == Worker::Role::Accumulator ) {
-    if ( worker.active_rays() >= WORKER_MAX_ACTIVE_SAMPLES )
-      return { false, false };
+  worker.to_be_assigned.items.push_back( info );
+  record_assign( worker.id, info );
+}
 
-    /* Q1: do we have any sample for this guy? */
-    const TileId tile_id = worker.tile_id;
-    auto& bag_queue = queued_ray_bags[treelet_count + tile_id];
+void LambdaMaster::assign_queued_bag( Worker& worker,
+                                      queue<QueuedBag>& bag_queue )
+{
+  const auto& bag = bag_queue.front();
 
-    bool work_to_do = ( bag_queue.size() > 0 );
+  if ( not bag.info.sample_bag ) {
+    const uint64_t wait
+      = duration_cast<microseconds>( steady_clock::now() - bag.queued_at )
+          .count();
 
-    if ( not work_to_do ) {
-      return { true, false };
-    }
+    treelets[bag.info.treelet_id].queue_wait.add( wait );
+    recent_queue_wait.add( wait );
+  }
 
-    if ( worker.active_rays() < WORKER_MAX_ACTIVE_SAMPLES ) {
-      *worker.to_be_assigned.add_items() = to_protobuf( bag_queue.front() );
-      record_assign( worker.id, bag_queue.front() );
-      bag_queue.pop();
-      queued_ray_bags_count--;
+  assign_bag( worker, bag.info );
+  bag_queue.pop();
+  queued_ray_bags_count--;
+}
 
-      return { worker.active_rays() < WORKER_MAX_ACTIVE_SAMPLES, true };
-    } else {
-      return { false, false };
-    }
+void LambdaMaster::flush_assignments()
+{
+  for ( const WorkerId worker_id : dirty_workers ) {
+    auto& worker = workers[worker_id];
+
+    worker.client.push_request(
+      { 0, OpCode::ProcessRayBag, worker.to_be_assigned.encode() } );
+
+    worker.to_be_assigned.clear();
+  }
+
+  dirty_workers.clear();
+}
+
+bool LambdaMaster::has_room( const Worker& worker ) const
+{
+  if ( worker.memory_limit
+       and worker.memory_usage
+             >= MEMORY_HIGH_WATERMARK * worker.memory_limit ) {
+    return false;
   }
 
-  // at this point, we know the worker is not an accumulator
+  const uint64_t memory
+    = worker.memory_limit ? worker.memory_limit : config.worker_memory;
 
-  /* return if the worker already has enough work */
-  if ( worker.active_rays() >= WORKER_MAX_ACTIVE_RAYS )
-    return { false, false };
+  const double share = ( worker.role == Worker::Role::Accumulator )
+                         ? config.accumulator_work_share
+                         : config.tracer_work_share;
 
-  /* return, if the worker doesn't have any treelets */
-  if ( worker.treelets.empty() )
-    return { false, false };
+  return worker.active_bytes() < share * memory;
+}
 
-  const TreeletId treelet_id = worker.treelets[0];
-  auto& bag_queue = queued_ray_bags[treelet_id];
+void LambdaMaster::handle_queued_ray_bags()
+{
+  const auto start = steady_clock::now();
 
-  /* Q1: do we have any rays to generate? */
-  bool rays_to_generate = tiles.camera_rays_remaining() && ( treelet_id == 0 );
+  /* how many bags a worker gets each time it's picked */
+  constexpr size_t ASSIGN_BATCH = 4;
 
-  /* Q2: do we have any work for this worker? */
-  bool work_to_do = ( bag_queue.size() > 0 );
+  /* (1) index the free workers by the treelets they have; accumulators
+     only ever take the samples of their own tile */
+  vector<WorkerId> candidates;
+  vector<TreeletId> ready_treelets;
 
-  if ( !rays_to_generate && !work_to_do ) {
-    return { true, false };
-  }
+  for ( const WorkerId worker_id : free_workers ) {
+    auto& worker = workers[worker_id];
 
-  if ( ( rays_to_generate || work_to_do )
-       && worker.active_rays() < WORKER_MAX_ACTIVE_RAYS ) {
-    if ( rays_to_generate && !work_to_do ) {
-      tiles.send_worker_tile( worker );
-      rays_to_generate = tiles.camera_rays_remaining();
-    } else {
-      /* only if work_to_do or the coin flip returned false */
-      *worker.to_be_assigned.add_items() = to_protobuf( bag_queue.front() );
-      record_assign( worker.id, bag_queue.front() );
-
-      bag_queue.pop();
-      queued_ray_bags_count--;
+    /* a worker can be on the list more than once */
+    if ( worker.marked_free or worker.state != Worker::State::Active
+         or not has_room( worker )
+         or ( worker.role == Worker::Role::Tracer
+              and worker.treelets.empty() ) ) {
+      continue;
     }
 
-    return { worker.active_rays() < WORKER_MAX_ACTIVE_RAYS, true };
+    worker.marked_free = true;
+    candidates.push_back( worker_id );
+
+    if ( worker.role == Worker::Role::Accumulator ) {
+      auto& bag_queue = queued_ray_bags[treelet_count + worker.tile_id];
+
+      while ( not bag_queue.empty() and has_room( worker ) ) {
+        assign_queued_bag( worker, bag_queue );
+      }
+
+      continue;
+    }
+
+    for ( const TreeletId tid : worker.treelets ) {
+      if ( ready_workers[tid].empty() ) {
+        ready_treelets.push_back( tid );
+      }
+
+      ready_workers[tid].push_back( worker_id );
+    }
   }
 
-  return { worker.active_rays() < WORKER_MAX_ACTIVE_RAYS, false };
-}
+  /* (2) longest queues first, as a worker with more than one treelet should
+     take from the longest one */
+  sort( ready_treelets.begin(),
+        ready_treelets.end(),
+        [this]( const TreeletId a, const TreeletId b ) {
+          return queued_ray_bags[a].size() > queued_ray_bags[b].size();
+        } );
 
-void LambdaMaster::handle_queued_ray_bags()
-{
-  shuffle( free_workers.begin(), free_workers.end(), rand_engine );
-  bool should_continue;
+  using LoadedWorker = pair<size_t, WorkerId>;
 
-  do {
-    should_continue = false;
+  for ( const TreeletId tid : ready_treelets ) {
+    auto& bag_queue = queued_ray_bags[tid];
 
-    for ( const WorkerId worker_id : free_workers ) {
-      auto& worker = workers[worker_id];
+    /* the least loaded worker gets the next batch */
+    priority_queue<LoadedWorker, vector<LoadedWorker>, greater<LoadedWorker>>
+      ready;
 
-      auto [worker_free, work_assigned] = assign_work( worker );
-      should_continue = should_continue || work_assigned;
+    if ( not bag_queue.empty() ) {
+      for ( const WorkerId worker_id : ready_workers[tid] ) {
+        const auto& worker = workers[worker_id];
 
-      worker.marked_free = worker_free;
+        if ( has_room( worker ) ) {
+          ready.emplace( worker.outstanding_bytes, worker_id );
+        }
+      }
     }
-  } while ( should_continue );
 
-  vector<WorkerId> new_free_workers;
-  new_free_workers.reserve( free_workers.size() );
+    while ( not bag_queue.empty() and not ready.empty() ) {
+      auto& worker = workers[ready.top().second];
+      ready.pop();
 
-  for ( auto& worker : workers ) {
-    if ( worker.to_be_assigned.items_size() ) {
-      worker.client.push_request(
-        { 0,
-          OpCode::ProcessRayBag,
-          protoutil::to_string( worker.to_be_assigned ) } );
+      for ( size_t i = 0;
+            i < ASSIGN_BATCH and not bag_queue.empty() and has_room( worker );
+            i++ ) {
+        assign_queued_bag( worker, bag_queue );
+      }
 
-      worker.to_be_assigned.Clear();
+      if ( has_room( worker ) ) {
+        ready.emplace( worker.outstanding_bytes, worker.id );
+      }
     }
 
-    if ( worker.marked_free ) {
-      worker.marked_free = false;
-      new_free_workers.push_back( worker.id );
+    /* (3) the workers with treelet 0 that are left generate camera rays */
+    if ( tid == 0 ) {
+      for ( const WorkerId worker_id : ready_workers[tid] ) {
+        auto& worker = workers[worker_id];
+
+        while ( tiles.camera_rays_remaining() and has_room( worker ) ) {
+          tiles.send_worker_tile( worker );
+        }
+      }
     }
+
+    ready_workers[tid].clear();
   }
 
-  swap( free_workers, new_free_workers );
+  /* (4) whoever still has room stays on the list */
+  free_workers.clear();
+
+  for ( const WorkerId worker_id : candidates ) {
+    auto& worker = workers[worker_id];
+    worker.marked_free = false;
+
+    if ( has_room( worker ) ) {
+      free_workers.push_back( worker_id );
+    }
+  }
+
+  flush_assignments();
+
+  dispatch_time += steady_clock::now() - start;
 }
 
 template<class T, class C>
@@ -141,6 +208,38 @@ void LambdaMaster::move_from_pending_to_queued( const TreeletId treelet_id )
 
 void LambdaMaster::move_from_queued_to_pending( const TreeletId treelet_id )
 {
-  queued_ray_bags_count -= pending_ray_bags[treelet_id].size();
+  queued_ray_bags_count -= queued_ray_bags[treelet_id].size();
   move_from_to( queued_ray_bags[treelet_id], pending_ray_bags[treelet_id] );
 }
+
+void LambdaMaster::queue_ray_bag( const RayBagInfo& info )
+{
+  if ( unassigned_treelets.count( info.treelet_id ) == 0 ) {
+    queued_ray_bags[info.treelet_id].push( { info } );
+    queued_ray_bags_count++;
+  } else {
+    pending_ray_bags[info.treelet_id].push( { info } );
+  }
+}
+
+void LambdaMaster::recover_worker( Worker& worker )
+{
+  worker.state = Worker::State::Terminated;
+  Worker::active_count[worker.role]--;
+
+  for ( const TreeletId tid : worker.treelets ) {
+    auto& treelet = treelets[tid];
+    treelet.workers.erase( worker.id );
+
+    /* nobody else has this treelet; ask for a new worker */
+    if ( treelet.workers.empty() ) {
+      unassigned_treelets.insert( tid );
+      move_from_queued_to_pending( tid );
+
+      treelets_to_spawn.emplace_back( 1, tid );
+      treelet.pending_workers++;
+    }
+  }
+
+  worker.treelets.clear();
+}
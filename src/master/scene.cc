@@ -1,8 +1,10 @@
 #include <pbrt/core/geometry.h>
+#include <pbrt/raystate.h>
 
 #include "lambda-master.hh"
 #include "messages/message.hh"
 #include "messages/utils.hh"
+#include "util/fileutils.hh"
 
 using namespace std;
 using namespace r2t2;
@@ -14,7 +16,13 @@ using OpCode = Message::OpCode;
 
 void LambdaMaster::assign_object( Worker& worker, const SceneObject& object )
 {
-  worker.objects.insert( object );
+  SceneObject obj { object };
+
+  /* alternative objects are uploaded by us, and never compressed */
+  obj.compressed
+    = obj.alt_name.empty() and compressed_objects.count( obj.key ) > 0;
+
+  worker.objects.insert( move( obj ) );
 }
 
 void LambdaMaster::assign_treelet( Worker& worker, Treelet& treelet )
@@ -34,6 +42,48 @@ void LambdaMaster::assign_treelet( Worker& worker, Treelet& treelet )
   }
 }
 
+void LambdaMaster::swap_treelet( Worker& worker,
+                                 Treelet& treelet,
+                                 const bool keep_current )
+{
+  const TreeletId old_treelet_id = worker.treelets.back();
+  const auto old_objects = worker.objects;
+
+  if ( not keep_current ) {
+    if ( config.write_stat_logs ) {
+      for ( const TreeletId tid : worker.treelets ) {
+        alloc_log.append( worker.id, tid, "remove" );
+      }
+    }
+
+    worker.objects.clear();
+    worker.treelets.clear();
+    assign_base_objects( worker );
+  }
+
+  assign_treelet( worker, treelet );
+
+  if ( config.write_stat_logs ) {
+    alloc_log.append( worker.id, treelet.id, "add" );
+  }
+
+  /* the worker keeps whatever both treelets need */
+  protobuf::SwapTreelet proto;
+  proto.set_old_treelet_id( old_treelet_id );
+  proto.set_new_treelet_id( treelet.id );
+  proto.set_keep_old_treelets( keep_current );
+
+  for ( const SceneObject& obj : worker.objects ) {
+    if ( old_objects.count( obj ) == 0 ) {
+      *proto.mutable_objects()->add_objects() = to_protobuf( obj );
+    }
+  }
+
+  worker.state = Worker::State::Swapping;
+  worker.client.push_request(
+    { 0, OpCode::SwapTreelet, protoutil::to_string( proto ) } );
+}
+
 vector<SceneObject> LambdaMaster::list_base_objects() const
 {
   vector<SceneObject> res;
@@ -58,6 +108,71 @@ void LambdaMaster::assign_base_objects( Worker& worker )
   }
 }
 
+void LambdaMaster::load_compression_manifest( const string& scene_path )
+{
+  const auto manifest_path
+    = filesystem::path( scene_path ) / COMPRESSION_MANIFEST_NAME;
+
+  try {
+    scene_storage_backend->get(
+      { { COMPRESSION_MANIFEST_NAME, manifest_path } } );
+  } catch ( const exception& ) {
+    /* the scene is only stored uncompressed */
+    return;
+  }
+
+  protobuf::CompressionManifest manifest;
+  protoutil::from_json( roost::read_file( manifest_path ), manifest );
+
+  map<string, const protobuf::CompressionManifest::Object*> manifest_objects;
+  for ( const auto& obj : manifest.objects() ) {
+    manifest_objects.emplace( obj.name(), &obj );
+  }
+
+  /* every object that a worker might be asked to fetch */
+  set<ObjectKey> keys;
+
+  for ( const auto type : SceneData::base_object_types ) {
+    keys.insert( { type, 0 } );
+  }
+
+  for ( TreeletId id = 0; id < scene.base.GetTreeletCount(); id++ ) {
+    keys.insert( { ObjectType::Treelet, id } );
+
+    for ( const auto& dependency : scene.base.GetTreeletDependencies( id ) ) {
+      keys.insert( dependency );
+    }
+  }
+
+  map<string, pair<uint64_t, uint64_t>> sizes;
+
+  for ( const auto& key : keys ) {
+    const auto name = scene::GetObjectName( key.type, key.id );
+    const auto it = manifest_objects.find( name );
+
+    if ( it == manifest_objects.end() ) {
+      continue;
+    }
+
+    compressed_objects.insert( key );
+
+    /* object names are a per-type prefix followed by the id */
+    const auto type
+      = name.substr( 0, name.find_last_not_of( "0123456789" ) + 1 );
+    sizes[type].first += it->second->size();
+    sizes[type].second += it->second->compressed_size();
+  }
+
+  for ( const auto& [type, size] : sizes ) {
+    compression_ratios[type]
+      = 1.0 * size.first / max<uint64_t>( size.second, 1 );
+  }
+
+  cout << "\u2198 Workers will fetch "
+       << pluralize( "compressed object", compressed_objects.size() ) << "."
+       << endl;
+}
+
 LambdaMaster::SceneData::SceneData( const std::string& scene_path,
                                     const int samples_per_pixel,
                                     const optional<Bounds2i>& crop_window )
@@ -148,6 +263,8 @@ void LambdaMaster::Tiles::send_worker_tile( Worker& worker )
   proto.set_y1( next_tile.pMax.y );
 
   worker.rays.camera += next_tile.Area() * tile_spp;
+  worker.camera_bytes
+    += next_tile.Area() * tile_spp * RayState::MaxPackedSize;
 
   worker.client.push_request(
     { 0, OpCode::GenerateRays, protoutil::to_string( proto ) } );
@@ -2,18 +2,13 @@
 #include <chrono>
 #include <iomanip>
 #include <iterator>
-#include <numeric>
-#include <random>
+#include <limits>
 
 #include "lambda-master.hh"
 #include "messages/message.hh"
 #include "messages/utils.hh"
-#include "net/http_client.hh"
-#include "net/lambda.hh"
-#include "net/session.hh"
 #include "schedulers/scheduler.hh"
 #include "util/exception.hh"
-#include "util/random.hh"
 
 using namespace std;
 using namespace chrono;
@@ -22,47 +17,6 @@ using namespace meow;
 
 using OpCode = Message::OpCode;
 
-void LambdaMaster::invoke_workers( const size_t n_workers )
-{
-  if ( n_workers == 0 )
-    return;
-
-  if ( config.engines.empty() ) {
-    for ( size_t i = 0; i < n_workers; i++ ) {
-      HTTPRequest invocation_request
-        = LambdaInvocationRequest(
-            aws_credentials,
-            aws_region,
-            lambda_function_name,
-            invocation_payload,
-            LambdaInvocationRequest::InvocationType::EVENT,
-            LambdaInvocationRequest::LogType::NONE )
-            .to_http_request();
-
-      TCPSocket socket;
-      socket.set_blocking( false );
-      socket.connect( aws_address );
-      https_clients.emplace_back(
-        SSLSession { ssl_context.make_SSL_handle(), move( socket ) } );
-
-      auto client_it = prev( https_clients.end() );
-
-      client_it->install_rules(
-        loop,
-        https_rule_categories,
-        [client_it, this]( HTTPResponse&& ) {
-          finished_https_clients.push_back( client_it );
-        },
-        [] {},
-        [] {} );
-
-      client_it->push_request( move( invocation_request ) );
-    }
-  } else {
-    throw runtime_error( "external engines not implemented" );
-  }
-}
-
 void LambdaMaster::handle_reschedule()
 {
   reschedule_timer.read_event();
@@ -70,19 +24,47 @@ void LambdaMaster::handle_reschedule()
   /* (1) call the schedule function */
 
   auto start = steady_clock::now();
-  auto schedule = scheduler->schedule(
-    max_workers, treelet_stats, aggregated_stats, scene.total_paths );
 
-  if ( schedule ) {
+  vector<WorkerState> worker_states;
+
+  /* once per tracer, however many treelets it has */
+  for ( const auto& worker : workers ) {
+    if ( worker.role != Worker::Role::Tracer
+         or worker.state == Worker::State::Terminated
+         or worker.treelets.empty() ) {
+      continue;
+    }
+
+    worker_states.push_back( { worker.id,
+                               worker.treelets,
+                               worker.state == Worker::State::Active,
+                               worker.outstanding_bytes,
+                               worker.active_rays(),
+                               worker.stats.cpu_usage } );
+  }
+
+  auto plan = scheduler->plan( target_workers,
+                               treelet_stats,
+                               aggregated_stats,
+                               scene.total_paths,
+                               worker_states,
+                               treelet_transitions );
+
+  if ( plan ) {
     cerr << "\u2192 Rescheduling... ";
 
-    execute_schedule( *schedule );
+    execute_plan( *plan );
     auto end = steady_clock::now();
 
     cerr << "done (" << fixed << setprecision( 2 )
-         << duration_cast<milliseconds>( end - start ).count() << " ms)."
-         << endl;
+         << duration_cast<milliseconds>( end - start ).count() << " ms, "
+         << duration_cast<milliseconds>( dispatch_time ).count()
+         << " ms dispatching since the last tick)." << endl;
   }
+
+  /* how much of the master's single thread went into placing work */
+  tick_time = dispatch_time + ( steady_clock::now() - start );
+  dispatch_time = {};
 }
 
 void LambdaMaster::handle_worker_invocation()
@@ -92,72 +74,291 @@ void LambdaMaster::handle_worker_invocation()
   /* let's start as many workers as we can right now */
   const auto running_count = Worker::active_count[Worker::Role::Tracer];
   const size_t available_capacity
-    = ( this->max_workers > running_count )
-        ? static_cast<size_t>( this->max_workers - running_count )
+    = ( target_workers > running_count )
+        ? static_cast<size_t>( target_workers - running_count )
         : 0ul;
 
-  invoke_workers( min( available_capacity, treelets_to_spawn.size() ) );
+  /* minus the ones we've already asked for */
+  const size_t wanted = min( available_capacity, treelets_to_spawn.size() );
+  const size_t requested = requested_workers();
+
+  if ( wanted > requested ) {
+    invoke_workers( wanted - requested );
+  }
+
+  dispatch_invocations();
 }
 
-void LambdaMaster::execute_schedule( const Schedule& schedule )
+void LambdaMaster::execute_plan( const Plan& plan )
 {
-  /* is the schedule viable? */
-  if ( schedule.size() != treelets.size() ) {
-    throw runtime_error( "invalid schedule" );
+  /* whatever was waiting to be spawned is superseded by this plan */
+  treelets_to_spawn.clear();
+
+  for ( auto& treelet : treelets ) {
+    treelet.pending_workers = 0;
   }
 
-  const auto total_requested_workers
-    = accumulate( schedule.begin(), schedule.end(), 0ull );
+  for ( const auto& placement : plan ) {
+    if ( placement.action == Placement::Action::Keep ) {
+      continue;
+    }
 
-  if ( total_requested_workers > max_workers ) {
-    throw runtime_error( "not enough workers available for the schedule" );
-  }
+    if ( placement.treelet >= treelets.size() ) {
+      throw runtime_error( "invalid placement" );
+    }
 
-  /* let's plan */
-  vector<WorkerId> workers_to_take_down;
-  treelets_to_spawn.clear();
+    if ( placement.action == Placement::Action::Spawn ) {
+      auto& group = treelets_to_spawn.emplace_back( 1, placement.treelet );
+      group.insert(
+        group.end(), placement.group.begin(), placement.group.end() );
 
-  for ( TreeletId tid = 0; tid < treelets.size(); tid++ ) {
-    const size_t requested = schedule[tid];
-    const size_t current = treelets[tid].workers.size();
+      for ( const TreeletId tid : group ) {
+        treelets.at( tid ).pending_workers++;
+      }
 
-    if ( requested == current ) {
       continue;
-    } else if ( requested > current ) {
-      /* we need to start new workers */
-      treelets[tid].pending_workers = requested - current;
-      treelets_to_spawn.insert(
-        treelets_to_spawn.end(), requested - current, tid );
-    } else /* (requested < current) */ {
+    }
+
+    auto& worker = workers.at( placement.worker );
+
+    if ( placement.action == Placement::Action::Add ) {
+      swap_treelet( worker, treelets[placement.treelet], true );
+      continue;
+    }
+
+    /* the rest take the worker away from the treelets it has */
+    for ( const TreeletId tid : worker.treelets ) {
       auto& treelet_workers = treelets[tid].workers;
-      for ( size_t i = 0; i < current - requested; i++ ) {
-        auto it
-          = random::sample( treelet_workers.begin(), treelet_workers.end() );
-        workers_to_take_down.push_back( *it );
-        treelet_workers.erase( it );
-      }
+      treelet_workers.erase( worker.id );
 
       /* no workers are left for this treelet */
       if ( treelet_workers.empty() ) {
         unassigned_treelets.insert( tid );
         move_from_queued_to_pending( tid );
       }
+    }
 
-      treelets[tid].pending_workers = 0;
+    if ( placement.action == Placement::Action::Assign ) {
+      swap_treelet( worker, treelets[placement.treelet] );
+    } else /* Drain */ {
+      worker.state = Worker::State::FinishingUp;
+      worker.client.push_request( { 0, OpCode::FinishUp, "" } );
     }
   }
 
-  /* shuffling treeletsToSpawn */
-  random_device rd {};
-  mt19937 g { rd() };
-  shuffle( treelets_to_spawn.begin(), treelets_to_spawn.end(), g );
+  /* the rest will have to wait until we have available capacity */
+}
+
+void LambdaMaster::handle_autoscale()
+{
+  autoscale_timer.read_event();
+
+  /* growing is only worth it if a new worker adds at least this share of
+     what an average one does */
+  constexpr double MIN_MARGINAL_SPEEDUP = 0.5;
+
+  /* how far ahead of the deadline we're happy to be */
+  constexpr double DEADLINE_SLACK = 0.1;
+
+  const auto now = steady_clock::now();
+  const uint32_t running = Worker::active_count[Worker::Role::Tracer];
 
-  /* let's kill the workers we can kill */
-  for ( const WorkerId worker_id : workers_to_take_down ) {
-    auto& worker = workers.at( worker_id );
-    worker.state = Worker::State::FinishingUp;
-    worker.client.push_request( { 0, OpCode::FinishUp, "" } );
+  if ( autoscale.last_tick == steady_clock::time_point {} ) {
+    autoscale.last_tick = now;
+    return;
   }
 
-  /* the rest will have to wait until we have available capacity */
+  const double dt = duration<double>( now - autoscale.last_tick ).count();
+  autoscale.last_tick = now;
+
+  autoscale.worker_seconds
+    += dt
+       * ( running + Worker::active_count[Worker::Role::Generator]
+           + Worker::active_count[Worker::Role::Accumulator] );
+
+  const uint64_t finished = aggregated_stats.finished_paths;
+  const double current_rate = ( finished - autoscale.last_finished_paths ) / dt;
+  autoscale.last_finished_paths = finished;
+
+  constexpr double ALPHA = 0.5;
+  autoscale.path_rate
+    = ( 1 - ALPHA ) * autoscale.path_rate + ALPHA * current_rate;
+
+  /* let the pool settle before we judge it */
+  if ( finished == 0 or running == 0 or not treelets_to_spawn.empty()
+       or now - autoscale.last_change < 3 * AUTOSCALE_INTERVAL ) {
+    return;
+  }
+
+  const double rate = autoscale.path_rate;
+  const double per_worker = rate / running;
+  const uint64_t remaining = scene.total_paths - finished;
+
+  if ( rate <= 0 or remaining == 0 ) {
+    return;
+  }
+
+  /* what one more worker buys us, judging by the last time we grew */
+  double marginal = per_worker;
+
+  if ( autoscale.previous_workers > 0
+       and autoscale.previous_workers < running ) {
+    marginal = max( 0.0,
+                    ( rate - autoscale.previous_rate )
+                      / ( running - autoscale.previous_workers ) );
+  }
+
+  const bool growth_pays = marginal >= MIN_MARGINAL_SPEEDUP * per_worker;
+  const uint32_t max_target = growth_pays ? max_workers : running;
+
+  /* we expect workers we add to do as well as the last ones we added, and
+     workers we take away to take an average share with them */
+  auto expected_rate = [&]( const uint32_t n ) {
+    return ( n >= running ) ? rate + marginal * ( n - running )
+                            : per_worker * n;
+  };
+
+  uint32_t target = running;
+  const char* reason = "";
+
+  if ( config.deadline ) {
+    const double time_left
+      = duration<double>( *config.deadline - ( now - start_time ) ).count();
+
+    const double needed = ( time_left > 0 )
+                            ? ( 1 + DEADLINE_SLACK ) * remaining / time_left
+                            : numeric_limits<double>::infinity();
+
+    /* the smallest pool that makes it in time */
+    target = max_target;
+    for ( uint32_t n = 1; n <= max_target; n++ ) {
+      if ( expected_rate( n ) >= needed ) {
+        target = n;
+        break;
+      }
+    }
+
+    reason = ( target > running ) ? "behind-deadline" : "ahead-of-deadline";
+  } else if ( config.cost_budget ) {
+    const double budget_left
+      = *config.cost_budget - autoscale.worker_seconds * config.worker_cost;
+
+    /* the largest pool that finishes within the budget */
+    target = 1;
+    for ( uint32_t n = max_target; n >= 1; n-- ) {
+      const double cost_to_finish
+        = n * config.worker_cost * remaining / expected_rate( n );
+
+      if ( cost_to_finish <= budget_left ) {
+        target = n;
+        break;
+      }
+    }
+
+    reason = ( target > running ) ? "under-budget" : "over-budget";
+  }
+
+  /* small changes aren't worth moving workers around for */
+  const uint32_t min_change = max( 1u, running / 10 );
+
+  if ( ( target > running ? target - running : running - target )
+       < min_change ) {
+    return;
+  }
+
+  Plan plan;
+
+  if ( target > running ) {
+    /* new workers go where the most bytes are waiting, per worker */
+    vector<size_t> worker_count( treelets.size() );
+    for ( TreeletId tid = 0; tid < treelets.size(); tid++ ) {
+      worker_count[tid] = treelets[tid].workers.size();
+    }
+
+    auto waiting = [&]( const TreeletId tid ) {
+      const auto& stats = treelet_stats[tid];
+      const double bytes = ( stats.enqueued.bytes > stats.dequeued.bytes )
+                             ? stats.enqueued.bytes - stats.dequeued.bytes
+                             : 0;
+      return bytes / ( worker_count[tid] + 1 );
+    };
+
+    for ( uint32_t i = running; i < target; i++ ) {
+      TreeletId busiest = 0;
+      for ( TreeletId tid = 1; tid < treelets.size(); tid++ ) {
+        if ( waiting( tid ) > waiting( busiest ) ) {
+          busiest = tid;
+        }
+      }
+
+      worker_count[busiest]++;
+      plan.push_back( { Placement::Action::Spawn, {}, busiest } );
+    }
+  } else {
+    /* the least loaded workers go first, but no treelet loses its last */
+    vector<Worker*> candidates;
+    for ( auto& worker : workers ) {
+      if ( worker.role == Worker::Role::Tracer
+           and worker.state == Worker::State::Active ) {
+        candidates.push_back( &worker );
+      }
+    }
+
+    sort( candidates.begin(),
+          candidates.end(),
+          []( const Worker* a, const Worker* b ) {
+            return a->outstanding_bytes < b->outstanding_bytes;
+          } );
+
+    vector<size_t> worker_count( treelets.size() );
+    for ( TreeletId tid = 0; tid < treelets.size(); tid++ ) {
+      worker_count[tid] = treelets[tid].workers.size();
+    }
+
+    for ( const Worker* worker : candidates ) {
+      if ( running - plan.size() <= target ) {
+        break;
+      }
+
+      const bool last_for_some
+        = any_of( worker->treelets.begin(),
+                  worker->treelets.end(),
+                  [&]( const TreeletId tid ) {
+                    return worker_count[tid] <= 1;
+                  } );
+
+      if ( last_for_some ) {
+        continue;
+      }
+
+      for ( const TreeletId tid : worker->treelets ) {
+        worker_count[tid]--;
+      }
+
+      plan.push_back( { Placement::Action::Drain, worker->id, {} } );
+    }
+
+    target = running - plan.size();
+  }
+
+  if ( plan.empty() ) {
+    return;
+  }
+
+  cerr << "\u2192 Autoscaling from " << running << " to " << target
+       << " workers (" << reason << ")." << endl;
+
+  if ( config.write_stat_logs ) {
+    alloc_log.append( column_log::NONE,
+                      column_log::NONE,
+                      "autoscale " + to_string( running ) + "->"
+                        + to_string( target ) + " " + reason );
+  }
+
+  autoscale.previous_workers = running;
+  autoscale.previous_rate = rate;
+  autoscale.last_change = now;
+
+  target_workers = target;
+  execute_plan( plan );
 }
@@ -0,0 +1,116 @@
+#include "shards.hh"
+
+#include <limits>
+
+#include "messages/utils.hh"
+
+using namespace std;
+using namespace r2t2;
+using namespace meow;
+
+using OpCode = Message::OpCode;
+
+/* tells a shard's thread to exit */
+constexpr WorkerId EXIT_SHARD = numeric_limits<WorkerId>::max();
+
+void r2t2::decode_message( DecodedMessage& decoded )
+{
+  const Message& message = *decoded.message;
+
+  decoded.ray_bags.clear();
+  decoded.worker_stats.reset();
+
+  switch ( message.opcode() ) {
+    case OpCode::RayBagEnqueued:
+    case OpCode::RayBagDequeued:
+      decoded.ray_bags.decode( message.payload() );
+      break;
+
+    case OpCode::WorkerStats:
+      protoutil::from_string( message.payload(),
+                              decoded.worker_stats.emplace() );
+      break;
+
+    default:
+      break;
+  }
+}
+
+MessageShards::MessageShards( const size_t count )
+{
+  for ( size_t i = 0; i < count; i++ ) {
+    auto& s = *shards_.emplace_back( make_unique<Shard>() );
+    s.thread = thread( &MessageShards::run, this, ref( s ) );
+  }
+}
+
+MessageShards::~MessageShards()
+{
+  for ( auto& s : shards_ ) {
+    s->input.enqueue( { EXIT_SHARD, {}, {}, {}, {} } );
+  }
+
+  for ( auto& s : shards_ ) {
+    s->thread.join();
+  }
+}
+
+MessageShards::Shard& MessageShards::shard( const WorkerId worker_id )
+{
+  return *shards_[worker_id % shards_.size()];
+}
+
+void MessageShards::run( Shard& s )
+{
+  DecodedMessage item;
+
+  while ( true ) {
+    s.input.wait_dequeue( item );
+
+    if ( item.worker_id == EXIT_SHARD ) {
+      return;
+    }
+
+    /* an exception would end the program from this thread */
+    if ( item.message ) {
+      try {
+        decode_message( item );
+      } catch ( ... ) {
+        item.error = current_exception();
+      }
+    }
+
+    s.output.enqueue( move( item ) );
+
+    /* one wakeup is enough for however many messages are ready */
+    if ( not signaled_.exchange( true ) ) {
+      decoded_fd_.write_event();
+    }
+  }
+}
+
+void MessageShards::push( const WorkerId worker_id, Message&& message )
+{
+  shard( worker_id ).input.enqueue( { worker_id, move( message ), {}, {}, {} } );
+}
+
+void MessageShards::push_close( const WorkerId worker_id )
+{
+  shard( worker_id ).input.enqueue( { worker_id, {}, {}, {}, {} } );
+}
+
+void MessageShards::pop( vector<DecodedMessage>& out )
+{
+  /* consume the event before lowering the flag, so that any shard that
+     sees the flag down from here on writes an event the loop will see */
+  decoded_fd_.read_event();
+  signaled_ = false;
+
+  DecodedMessage item;
+
+  for ( auto& s : shards_ ) {
+    while ( s->output.try_dequeue( item ) ) {
+      out.push_back( move( item ) );
+    }
+  }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "common/lambda.hh"
+#include "concurrentqueue/blockingconcurrentqueue.h"
+#include "concurrentqueue/concurrentqueue.h"
+#include "messages/bags.hh"
+#include "messages/message.hh"
+#include "r2t2.pb.h"
+#include "util/eventfd.hh"
+
+namespace r2t2 {
+
+/* a message from a worker, with its payload parsed if it's one of the kinds
+   that make up most of the traffic. No message means the connection to the
+   worker was closed. */
+struct DecodedMessage
+{
+  WorkerId worker_id {};
+  std::optional<meow::Message> message {};
+
+  RayBagBatch ray_bags {};
+  std::optional<protobuf::WorkerStats> worker_stats {};
+
+  /* set if the payload couldn't be decoded; the loop rethrows it, as it
+     would if it did the decoding itself */
+  std::exception_ptr error {};
+};
+
+/* parses the payload of `decoded.message`, reusing the memory that
+   `decoded` already has for the bags */
+void decode_message( DecodedMessage& decoded );
+
+/* Decodes the messages from the workers on a few threads, so that the event
+   loop only has to act on them. Every worker is pinned to one shard, and a
+   shard hands back its messages in the order it got them, so each worker's
+   messages (and the closing of its connection) are seen in order. */
+class MessageShards
+{
+private:
+  struct Shard
+  {
+    moodycamel::BlockingConcurrentQueue<DecodedMessage> input {};
+    moodycamel::ConcurrentQueue<DecodedMessage> output {};
+    std::thread thread {};
+  };
+
+  std::vector<std::unique_ptr<Shard>> shards_ {};
+  EventFD decoded_fd_ {};
+
+  /* set while decoded_fd_ has an event the loop hasn't read yet */
+  std::atomic<bool> signaled_ { false };
+
+  Shard& shard( const WorkerId worker_id );
+  void run( Shard& shard );
+
+public:
+  MessageShards( const size_t count );
+  ~MessageShards();
+
+  MessageShards( const MessageShards& ) = delete;
+  MessageShards& operator=( const MessageShards& ) = delete;
+
+  void push( const WorkerId worker_id, meow::Message&& message );
+  void push_close( const WorkerId worker_id );
+
+  /* becomes readable when there are decoded messages to pop */
+  EventFD& decoded_fd() { return decoded_fd_; }
+
+  /* appends every message that is ready to `out`; call it when
+     decoded_fd() is readable */
+  void pop( std::vector<DecodedMessage>& out );
+};
+
+} // namespace r2t2
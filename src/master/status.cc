@@ -67,6 +67,8 @@ void LambdaMaster::handle_status_message()
 
   auto& s = aggregated_stats;
 
+  auto p99 = []( const Histogram& h ) { return h.quantile( 0.99 ) / 1000; };
+
   // clang-format off
   ostringstream oss;
   oss << "\033[0m" << fixed << setprecision(2)
@@ -79,7 +81,7 @@ void LambdaMaster::handle_status_message()
               << "/" << ray_generators << " "
 
       << BG() << " \u03bb " << Worker::active_count[Worker::Role::Tracer]
-              << "/" << max_workers
+              << "/" << target_workers
               << " "
 
       << BG_ALERT << print_lagging_workers(lagging_rt_workers)
@@ -91,6 +93,10 @@ void LambdaMaster::handle_status_message()
               
       << BG() << " \u29d6 " << treelets_to_spawn.size() << " "
 
+      // master time per reschedule tick
+      << BG() << " \u23f1 "
+              << duration_cast<milliseconds>(tick_time).count() << "ms "
+
       // initialized workers
       << BG() << " \u2713 " << initialized_workers << " "
 
@@ -105,6 +111,14 @@ void LambdaMaster::handle_status_message()
       << BG() << " \u2193 " << percent(s.dequeued.bytes, s.enqueued.bytes)
               << "% "
 
+      // p99 bag latencies: queue wait, upload, download
+      << BG() << " \u29d7 "
+              << p99(recent_queue_wait) << "/"
+              << p99(recent_bag_latencies[to_underlying(BagStage::Upload)])
+              << "/"
+              << p99(recent_bag_latencies[to_underlying(BagStage::Download)])
+              << "ms "
+
       // elapsed time
       << BG() << " " << setfill('0')
               << setw(2) << (elapsed_seconds / 60) << ":" << setw(2)
@@ -114,4 +128,10 @@ void LambdaMaster::handle_status_message()
   // clang-format on
 
   StatusBar::set_text( oss.str() );
+
+  for ( auto& histogram : recent_bag_latencies ) {
+    histogram.clear();
+  }
+
+  recent_queue_wait.clear();
 }
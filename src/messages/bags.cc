@@ -0,0 +1,149 @@
+#include "bags.hh"
+
+#include <stdexcept>
+
+using namespace std;
+using namespace r2t2;
+
+namespace {
+
+constexpr uint64_t TRACKED = 1;
+constexpr uint64_t SAMPLE_BAG = 2;
+constexpr uint64_t HAS_SOURCE = 4;
+
+size_t varint_size( uint64_t value )
+{
+  size_t size = 1;
+
+  while ( value >= 0x80 ) {
+    value >>= 7;
+    size++;
+  }
+
+  return size;
+}
+
+char* put_varint( char* out, uint64_t value )
+{
+  while ( value >= 0x80 ) {
+    *out++ = static_cast<char>( ( value & 0x7f ) | 0x80 );
+    value >>= 7;
+  }
+
+  *out++ = static_cast<char>( value );
+  return out;
+}
+
+uint64_t get_varint( const char*& in, const char* end )
+{
+  uint64_t value = 0;
+
+  for ( unsigned shift = 0; shift < 64; shift += 7 ) {
+    if ( in == end ) {
+      throw runtime_error( "bag batch: truncated varint" );
+    }
+
+    const auto byte = static_cast<uint8_t>( *in++ );
+    value |= static_cast<uint64_t>( byte & 0x7f ) << shift;
+
+    if ( not( byte & 0x80 ) ) {
+      return value;
+    }
+  }
+
+  throw runtime_error( "bag batch: varint is too long" );
+}
+
+uint64_t flags_of( const RayBagInfo& info )
+{
+  return ( info.tracked ? TRACKED : 0 ) | ( info.sample_bag ? SAMPLE_BAG : 0 )
+         | ( info.source_treelet_id ? HAS_SOURCE : 0 );
+}
+
+}
+
+void RayBagBatch::clear()
+{
+  rays_generated = 0;
+  rays_terminated = 0;
+  items.clear();
+}
+
+string RayBagBatch::encode() const
+{
+  /* sized up front, so that it's allocated once */
+  size_t size = varint_size( rays_generated ) + varint_size( rays_terminated )
+                + varint_size( items.size() );
+
+  for ( const auto& info : items ) {
+    size += varint_size( flags_of( info ) ) + varint_size( info.worker_id )
+            + varint_size( info.treelet_id ) + varint_size( info.bag_id )
+            + varint_size( info.ray_count ) + varint_size( info.bag_size )
+            + ( info.source_treelet_id
+                  ? varint_size( *info.source_treelet_id )
+                  : 0 );
+  }
+
+  string data( size, '\0' );
+  char* out = data.data();
+
+  out = put_varint( out, rays_generated );
+  out = put_varint( out, rays_terminated );
+  out = put_varint( out, items.size() );
+
+  for ( const auto& info : items ) {
+    out = put_varint( out, flags_of( info ) );
+    out = put_varint( out, info.worker_id );
+    out = put_varint( out, info.treelet_id );
+    out = put_varint( out, info.bag_id );
+    out = put_varint( out, info.ray_count );
+    out = put_varint( out, info.bag_size );
+
+    if ( info.source_treelet_id ) {
+      out = put_varint( out, *info.source_treelet_id );
+    }
+  }
+
+  return data;
+}
+
+void RayBagBatch::decode( const string_view data )
+{
+  const char* in = data.data();
+  const char* end = in + data.length();
+
+  rays_generated = get_varint( in, end );
+  rays_terminated = get_varint( in, end );
+
+  const uint64_t count = get_varint( in, end );
+
+  /* every bag takes at least six bytes */
+  if ( count > data.length() / 6 ) {
+    throw runtime_error( "bag batch: bad item count" );
+  }
+
+  items.resize( count );
+
+  for ( auto& info : items ) {
+    const uint64_t flags = get_varint( in, end );
+
+    info.tracked = flags & TRACKED;
+    info.sample_bag = flags & SAMPLE_BAG;
+    info.worker_id = get_varint( in, end );
+    info.treelet_id = static_cast<TreeletId>( get_varint( in, end ) );
+    info.bag_id = get_varint( in, end );
+    info.ray_count = get_varint( in, end );
+    info.bag_size = get_varint( in, end );
+
+    if ( flags & HAS_SOURCE ) {
+      info.source_treelet_id
+        = static_cast<TreeletId>( get_varint( in, end ) );
+    } else {
+      info.source_treelet_id.reset();
+    }
+  }
+
+  if ( in != end ) {
+    throw runtime_error( "bag batch: trailing bytes" );
+  }
+}
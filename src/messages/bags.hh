@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common/lambda.hh"
+
+namespace r2t2 {
+
+/* The bag metadata in RayBagEnqueued, RayBagDequeued and ProcessRayBag.
+   These are most of what goes between the workers and the master, so they
+   skip protobuf for a flat encoding, where every field is a varint:
+
+     rays_generated rays_terminated count
+     { flags worker_id treelet_id bag_id ray_count bag_size [source] }*
+
+   flags are tracked (1), sample_bag (2) and has a source treelet (4).
+   A batch is meant to be kept around and reused: clear() keeps the memory
+   of its items, and decode() overwrites them in place. */
+struct RayBagBatch
+{
+  uint64_t rays_generated { 0 };
+  uint64_t rays_terminated { 0 };
+  std::vector<RayBagInfo> items {};
+
+  void clear();
+  bool empty() const { return items.empty(); }
+
+  std::string encode() const;
+  void decode( const std::string_view data );
+};
+
+} // namespace r2t2
@@ -35,6 +35,9 @@ public:
     ProcessSampleBag,
     SampleBagProcessed,
 
+    // Rescheduling
+    SwapTreelet,
+
     COUNT
   };
 
@@ -53,7 +56,8 @@ public:
         "Bye",
         "SetupAccumulator",
         "ProcessSampleBag",
-        "SampleBagProcessed" };
+        "SampleBagProcessed",
+        "SwapTreelet" };
 
   constexpr static size_t HEADER_LENGTH = 13;
 
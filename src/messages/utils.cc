@@ -1,8 +1,10 @@
 #include "utils.hh"
 
+#include <algorithm>
 #include <chrono>
 #include <memory>
 #include <stdexcept>
+#include <vector>
 
 #include "util/util.hh"
 
@@ -16,19 +18,7 @@ protobuf::SceneObject to_protobuf( const SceneObject& object )
   proto.set_type( to_underlying( object.key.type ) );
   proto.set_id( object.key.id );
   proto.set_alt_name( object.alt_name );
-  return proto;
-}
-
-protobuf::RayBagInfo to_protobuf( const RayBagInfo& info )
-{
-  protobuf::RayBagInfo proto;
-  proto.set_tracked( info.tracked );
-  proto.set_worker_id( info.worker_id );
-  proto.set_treelet_id( info.treelet_id );
-  proto.set_bag_id( info.bag_id );
-  proto.set_ray_count( info.ray_count );
-  proto.set_bag_size( info.bag_size );
-  proto.set_sample_bag( info.sample_bag );
+  proto.set_compressed( object.compressed );
   return proto;
 }
 
@@ -40,6 +30,26 @@ protobuf::WorkerStats to_protobuf( const WorkerStats& stats )
   return proto;
 }
 
+protobuf::HistogramUInt64 to_protobuf( const Histogram& histogram )
+{
+  protobuf::HistogramUInt64 proto;
+  const auto& bins = histogram.bins();
+
+  /* only the bins between the first and the last non-empty one are sent */
+  const auto first = find_if( bins.begin(), bins.end(), []( auto c ) {
+    return c > 0;
+  } );
+
+  *proto.mutable_bins() = { first, bins.end() };
+  proto.set_sub_bucket_bits( Histogram::SUB_BUCKET_BITS );
+  proto.set_first_bin( first - bins.begin() );
+  proto.set_count( histogram.count() );
+  proto.set_sum( histogram.sum() );
+  proto.set_min( histogram.min() );
+  proto.set_max( histogram.max() );
+  return proto;
+}
+
 protobuf::AccumulatedStats to_protobuf( const pbrt::AccumulatedStats& stats )
 {
   protobuf::AccumulatedStats proto;
@@ -113,16 +123,11 @@ protobuf::AccumulatedStats to_protobuf( const pbrt::AccumulatedStats& stats )
 
 SceneObject from_protobuf( const protobuf::SceneObject& object )
 {
-  return { { static_cast<pbrt::ObjectType>( object.type() ), object.id() },
-           object.alt_name() };
-}
-
-RayBagInfo from_protobuf( const protobuf::RayBagInfo& proto )
-{
-  RayBagInfo res { proto.worker_id(), proto.treelet_id(), proto.bag_id(),
-                   proto.ray_count(), proto.bag_size(),   proto.sample_bag() };
+  SceneObject res { { static_cast<pbrt::ObjectType>( object.type() ),
+                      object.id() },
+                    object.alt_name() };
 
-  res.tracked = proto.tracked();
+  res.compressed = object.compressed();
   return res;
 }
 
@@ -131,6 +136,23 @@ WorkerStats from_protobuf( const protobuf::WorkerStats& proto )
   return { proto.finished_paths(), proto.cpu_usage() };
 }
 
+Histogram from_protobuf( const protobuf::HistogramUInt64& proto )
+{
+  if ( proto.count() == 0 ) {
+    return {};
+  }
+
+  if ( proto.sub_bucket_bits() != Histogram::SUB_BUCKET_BITS ) {
+    throw runtime_error( "histogram has a different number of sub-buckets" );
+  }
+
+  return { proto.first_bin(),
+           { proto.bins().begin(), proto.bins().end() },
+           proto.sum(),
+           proto.min(),
+           proto.max() };
+}
+
 pbrt::AccumulatedStats from_protobuf( const protobuf::AccumulatedStats& proto )
 {
   pbrt::AccumulatedStats obj;
@@ -6,6 +6,7 @@
 #include "common/lambda.hh"
 #include "common/stats.hh"
 #include "r2t2.pb.h"
+#include "util/histogram.hh"
 
 namespace protoutil {
 
@@ -53,13 +54,13 @@ void from_json( const std::string& data, ProtobufType& dest )
 namespace r2t2 {
 
 protobuf::SceneObject to_protobuf( const SceneObject& obj );
-protobuf::RayBagInfo to_protobuf( const RayBagInfo& obj );
 protobuf::WorkerStats to_protobuf( const WorkerStats& obj );
+protobuf::HistogramUInt64 to_protobuf( const Histogram& obj );
 protobuf::AccumulatedStats to_protobuf( const pbrt::AccumulatedStats& obj );
 
 SceneObject from_protobuf( const protobuf::SceneObject& proto );
-RayBagInfo from_protobuf( const protobuf::RayBagInfo& proto );
 WorkerStats from_protobuf( const protobuf::WorkerStats& proto );
+Histogram from_protobuf( const protobuf::HistogramUInt64& proto );
 pbrt::AccumulatedStats from_protobuf( const protobuf::AccumulatedStats& proto );
 
 } // namespace r2t2
@@ -48,12 +48,12 @@ size_t HTTPMessage::read_in_body( const string_view str )
   if ( body_size_is_known() ) {
     /* body size known in advance */
 
-    assert( body_.size() <= expected_body_size() );
+    assert( body_length_ <= expected_body_size() );
     const size_t amount_to_append
-      = min( expected_body_size() - body_.size(), str.size() );
+      = min( expected_body_size() - body_length_, str.size() );
 
-    body_.append( str.substr( 0, amount_to_append ) );
-    if ( body_.size() == expected_body_size() ) {
+    append_to_body( str.substr( 0, amount_to_append ) );
+    if ( body_length_ == expected_body_size() ) {
       state_ = COMPLETE;
     }
 
@@ -64,6 +64,23 @@ size_t HTTPMessage::read_in_body( const string_view str )
   }
 }
 
+void HTTPMessage::append_to_body( const string_view str )
+{
+  body_length_ += str.size();
+
+  if ( body_sink_ ) {
+    body_sink_( str );
+  } else {
+    body_.append( str );
+  }
+}
+
+void HTTPMessage::set_body_sink( BodySink&& sink )
+{
+  assert( state_ < BODY_PENDING );
+  body_sink_ = move( sink );
+}
+
 void HTTPMessage::eof()
 {
   switch ( state() ) {
@@ -186,5 +203,6 @@ HTTPMessage::HTTPMessage( string&& first_line,
   : first_line_( std::move( first_line ) )
   , headers_( std::move( headers ) )
   , body_( std::move( body ) )
+  , body_length_( body_.size() )
   , state_( COMPLETE )
 {}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -18,6 +19,9 @@ static const std::string CRLF = "\r\n";
 
 class HTTPMessage
 {
+public:
+  using BodySink = std::function<void( const std::string_view )>;
+
 private:
   /* first member of pair specifies whether body size is known in advance,
      and second member is size (if known in advance) */
@@ -43,6 +47,12 @@ protected:
   /* body may be empty */
   std::string body_ {};
 
+  /* if set, the body is handed to it as it arrives, instead of to body_ */
+  BodySink body_sink_ {};
+  size_t body_length_ { 0 };
+
+  void append_to_body( const std::string_view str );
+
   /* state of an in-progress request or response */
   HTTPMessageState state_ { FIRST_LINE_PENDING };
 
@@ -65,8 +75,9 @@ public:
   size_t read_in_body( const std::string_view str );
   void eof();
 
-  /* setter */
+  /* setters */
   void add_header( const HTTPHeader& header );
+  void set_body_sink( BodySink&& sink );
 
   /* getters */
   bool body_size_is_known() const;
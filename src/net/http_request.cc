@@ -11,7 +11,8 @@ void HTTPRequest::calculate_expected_body_size()
 {
   assert( state_ == BODY_PENDING );
   if ( first_line_.substr( 0, 4 ) == "GET "
-       or first_line_.substr( 0, 5 ) == "HEAD " ) {
+       or first_line_.substr( 0, 5 ) == "HEAD "
+       or first_line_.substr( 0, 7 ) == "DELETE " ) {
     set_expected_body_size( true, 0 );
   } else if ( first_line_.substr( 0, 5 ) == "POST "
               or first_line_.substr( 0, 4 ) == "PUT " ) {
@@ -25,6 +25,11 @@ void HTTPResponse::calculate_expected_body_size()
 {
   assert( state_ == BODY_PENDING );
 
+  /* error responses keep their body, to explain what went wrong */
+  if ( status_code().at( 0 ) != '2' ) {
+    body_sink_ = {};
+  }
+
   /* implement rules of RFC 2616 section 4.4 ("Message Length") */
 
   if ( status_code().at( 0 ) == '1' or status_code() == "204"
@@ -80,11 +85,11 @@ size_t HTTPResponse::read_in_complex_body( const string_view str )
   auto amount_parsed = body_parser_->read( str );
   if ( amount_parsed == std::string::npos ) {
     /* all of it belongs to the body */
-    body_.append( str );
+    append_to_body( str );
     return str.size();
   } else {
     /* body is now complete */
-    body_.append( str.substr( 0, amount_parsed ) );
+    append_to_body( str.substr( 0, amount_parsed ) );
     state_ = COMPLETE;
     return amount_parsed;
   }
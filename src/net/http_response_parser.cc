@@ -14,6 +14,8 @@ void HTTPResponseParser::initialize_new_message()
   }
 
   message_in_progress_.set_request_is_head( requests_are_head_.front() );
+  message_in_progress_.set_body_sink( move( body_sinks_.front() ) );
 
   requests_are_head_.pop();
+  body_sinks_.pop();
 }
@@ -9,12 +9,16 @@ class HTTPResponseParser : public HTTPMessageSequence<HTTPResponse>
 private:
   /* Need this to handle RFC 2616 section 4.4 rule 1 */
   std::queue<bool> requests_are_head_ {};
+  std::queue<HTTPMessage::BodySink> body_sinks_ {};
 
   void initialize_new_message() override;
 
 public:
-  void new_request_arrived( const HTTPRequest& request )
+  /* the body of a successful response goes to `body_sink`, if given */
+  void new_request_arrived( const HTTPRequest& request,
+                            HTTPMessage::BodySink&& body_sink = {} )
   {
     requests_are_head_.push( request.is_head() );
+    body_sinks_.push( std::move( body_sink ) );
   }
 };
@@ -6,6 +6,7 @@
 #include <chrono>
 #include <fcntl.h>
 #include <future>
+#include <optional>
 #include <sys/types.h>
 #include <thread>
 
@@ -30,6 +31,10 @@ const static string UNSIGNED_PAYLOAD = "UNSIGNED-PAYLOAD";
 
 string S3::endpoint( const string& region, const string& bucket )
 {
+  if ( endpoint_override() ) {
+    return *endpoint_override();
+  }
+
   if ( region == "us-east-1" ) {
     return bucket + ".s3.amazonaws.com";
   } else {
@@ -111,6 +116,30 @@ S3DeleteRequest::S3DeleteRequest( const AWSCredentials& credentials,
                           {} );
 }
 
+const optional<string>& S3::endpoint_override()
+{
+  const static optional<string> override = []() -> optional<string> {
+    const char* value = getenv( "R2T2_S3_ENDPOINT" );
+    if ( value == nullptr or *value == '\0' ) {
+      return nullopt;
+    }
+
+    return string { value };
+  }();
+
+  return override;
+}
+
+Address S3::address( const string& endpoint, const string& service )
+{
+  if ( endpoint.find( ':' ) == string::npos ) {
+    return { endpoint, service };
+  }
+
+  const auto [host, port] = Address::decompose( endpoint );
+  return { host, to_string( port ) };
+}
+
 TCPSocket tcp_connection( const Address& address )
 {
   TCPSocket sock;
@@ -118,18 +147,68 @@ TCPSocket tcp_connection( const Address& address )
   return sock;
 }
 
+/* blocking connection to S3, over TLS or plain TCP (for local stand-ins) */
+class S3Connection
+{
+private:
+  optional<SSLContext> ssl_context_ {};
+  optional<SimpleSSLSession> ssl_session_ {};
+  optional<TCPSocket> socket_ {};
+
+public:
+  S3Connection( const Address& address, const bool use_tls )
+  {
+    if ( use_tls ) {
+      ssl_context_.emplace();
+      ssl_session_.emplace( ssl_context_->make_SSL_handle(),
+                            tcp_connection( address ) );
+    } else {
+      socket_.emplace( tcp_connection( address ) );
+    }
+  }
+
+  size_t read( simple_string_span buffer )
+  {
+    return ssl_session_ ? ssl_session_->read( buffer )
+                        : socket_->read( buffer );
+  }
+
+  void write( const string_view buffer )
+  {
+    if ( ssl_session_ ) {
+      ssl_session_->write( buffer );
+    } else {
+      socket_->write_all( buffer );
+    }
+  }
+};
+
 S3Client::S3Client( const AWSCredentials& credentials,
                     const S3ClientConfig& config )
   : credentials_( credentials )
   , config_( config )
 {}
 
+string S3Client::endpoint( const string& bucket ) const
+{
+  return ( config_.endpoint.length() > 0 )
+           ? config_.endpoint
+           : S3::endpoint( config_.region, bucket );
+}
+
+bool S3Client::use_tls() const
+{
+  if ( config_.endpoint.length() > 0 ) {
+    return config_.use_tls;
+  }
+
+  return not S3::endpoint_override();
+}
+
 HTTPRequest S3Client::create_download_request( const string& bucket,
                                                const string& object ) const
 {
-  const string endpoint = ( config_.endpoint.length() > 0 )
-                            ? config_.endpoint
-                            : S3::endpoint( config_.region, bucket );
+  const string endpoint = this->endpoint( bucket );
 
   S3GetRequest request { credentials_, endpoint, config_.region, object };
   return request.to_http_request();
@@ -139,11 +218,9 @@ void S3Client::download_file( const string& bucket,
                               const string& object,
                               string& output )
 {
-  const string endpoint = ( config_.endpoint.length() > 0 )
-                            ? config_.endpoint
-                            : S3::endpoint( config_.region, bucket );
+  const string endpoint = this->endpoint( bucket );
 
-  const Address s3_address { endpoint, "https" };
+  const Address s3_address = S3::address( endpoint, "https" );
 
   constexpr milliseconds backoff { 50 };
   size_t try_count = 0;
@@ -160,10 +237,8 @@ void S3Client::download_file( const string& bucket,
       this_thread::sleep_for( backoff * ( 1 << ( try_count - 2 ) ) );
     }
 
-    SSLContext ssl_context;
     HTTPResponseParser responses;
-    SimpleSSLSession s3 { ssl_context.make_SSL_handle(),
-                          tcp_connection( s3_address ) };
+    S3Connection s3 { s3_address, use_tls() };
 
     S3GetRequest request { credentials_, endpoint, config_.region, object };
     HTTPRequest outgoing_request = request.to_http_request();
@@ -222,10 +297,8 @@ void S3Client::upload_files(
   const vector<PutRequest>& upload_requests,
   const function<void( const PutRequest& )>& success_callback )
 {
-  const string endpoint = ( config_.endpoint.length() > 0 )
-                            ? config_.endpoint
-                            : S3::endpoint( config_.region, bucket );
-  const Address s3_address { endpoint, "https" };
+  const string endpoint = this->endpoint( bucket );
+  const Address s3_address = S3::address( endpoint, "https" );
 
   const size_t thread_count = config_.max_threads;
   const size_t batch_size = config_.max_batch_size;
@@ -245,10 +318,8 @@ void S3Client::upload_files(
           for ( size_t first_file_idx = index;
                 first_file_idx < upload_requests.size();
                 first_file_idx += thread_count * batch_size ) {
-            SSLContext ssl_context;
             HTTPResponseParser responses;
-            SimpleSSLSession s3 { ssl_context.make_SSL_handle(),
-                                  tcp_connection( s3_address ) };
+            S3Connection s3 { s3_address, use_tls() };
 
             size_t request_count = 0;
 
@@ -312,11 +383,9 @@ void S3Client::download_files(
   const vector<storage::GetRequest>& download_requests,
   const function<void( const storage::GetRequest& )>& success_callback )
 {
-  const string endpoint = ( config_.endpoint.length() > 0 )
-                            ? config_.endpoint
-                            : S3::endpoint( config_.region, bucket );
+  const string endpoint = this->endpoint( bucket );
 
-  const Address s3_address { endpoint, "https" };
+  const Address s3_address = S3::address( endpoint, "https" );
 
   const size_t thread_count = config_.max_threads;
   const size_t batch_size = config_.max_batch_size;
@@ -334,10 +403,8 @@ void S3Client::download_files(
           for ( size_t first_file_idx = index;
                 first_file_idx < download_requests.size();
                 first_file_idx += thread_count * batch_size ) {
-            SSLContext ssl_context;
             HTTPResponseParser responses;
-            SimpleSSLSession s3 { ssl_context.make_SSL_handle(),
-                                  tcp_connection( s3_address ) };
+            S3Connection s3 { s3_address, use_tls() };
 
             size_t expected_responses = 0;
 
@@ -6,10 +6,12 @@
 #include <filesystem>
 #include <functional>
 #include <map>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "address.hh"
 #include "aws.hh"
 #include "http_request.hh"
 #include "requests.hh"
@@ -20,6 +22,14 @@ class S3
 public:
   static std::string endpoint( const std::string& region,
                                const std::string& bucket );
+
+  /* if R2T2_S3_ENDPOINT is set (e.g., "127.0.0.1:9000"), every client and
+     transfer agent talks to that endpoint over plain HTTP instead of AWS */
+  static const std::optional<std::string>& endpoint_override();
+
+  /* resolves "host" or "host:port"; service is used when port is missing */
+  static Address address( const std::string& endpoint,
+                          const std::string& service );
 };
 
 class S3PutRequest : public AWSRequest
@@ -58,6 +68,7 @@ struct S3ClientConfig
   std::string endpoint {};
   size_t max_threads { 32 };
   size_t max_batch_size { 32 };
+  bool use_tls { true };
 };
 
 class S3Client
@@ -70,6 +81,9 @@ public:
   S3Client( const AWSCredentials& credentials,
             const S3ClientConfig& config = {} );
 
+  std::string endpoint( const std::string& bucket ) const;
+  bool use_tls() const;
+
   void download_file( const std::string& bucket,
                       const std::string& object,
                       std::string& output );
@@ -7,6 +7,13 @@ using namespace chrono;
 
 TransferAgent::~TransferAgent() {}
 
+void TransferAgent::record_latency( const Action& action )
+{
+  _latency.add(
+    duration_cast<microseconds>( steady_clock::now() - action.requested_at )
+      .count() );
+}
+
 void TransferAgent::do_action( Action&& action )
 {
   {
@@ -33,10 +40,27 @@ uint64_t TransferAgent::request_upload( const string& key,
   return _next_id++;
 }
 
+void TransferAgent::report_error( exception_ptr error )
+{
+  {
+    unique_lock<mutex> lock { _results_mutex };
+
+    if ( not _error ) {
+      _error = move( error );
+    }
+  }
+
+  _event_fd.write_event();
+}
+
 bool TransferAgent::try_pop( pair<uint64_t, string>& output )
 {
   unique_lock<mutex> lock { _results_mutex };
 
+  if ( _error ) {
+    rethrow_exception( _error );
+  }
+
   if ( _results.empty() )
     return false;
 
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstdint>
+#include <exception>
 #include <future>
 #include <iterator>
 #include <limits>
@@ -14,6 +16,7 @@
 #include "net/address.hh"
 #include "net/socket.hh"
 #include "util/eventfd.hh"
+#include "util/histogram.hh"
 
 class TransferAgent
 {
@@ -35,6 +38,9 @@ protected:
     std::string key;
     std::string data;
     uint64_t helper_data;
+    std::chrono::steady_clock::time_point requested_at {
+      std::chrono::steady_clock::now()
+    };
 
     Action( const uint64_t id_,
             const Task task_,
@@ -64,6 +70,16 @@ protected:
 
   EventFD _event_fd { false };
 
+  /* the first error one of the threads couldn't get past; popping the
+     results rethrows it on the caller's thread (guarded by _results_mutex) */
+  std::exception_ptr _error {};
+  void report_error( std::exception_ptr error );
+
+  /* microseconds from a request to its result; the agent's threads record
+     these as the results come in */
+  HistogramRecorder _latency {};
+  void record_latency( const Action& action );
+
   virtual void do_action( Action&& action );
   virtual void worker_thread( const size_t threadId ) = 0;
 
@@ -79,6 +95,8 @@ public:
 
   EventFD& eventfd() { return _event_fd; }
 
+  Histogram latency() const { return _latency.snapshot(); }
+
   bool empty() const;
   bool try_pop( std::pair<uint64_t, std::string>& output );
 
@@ -95,6 +113,10 @@ size_t TransferAgent::try_pop_bulk(
 {
   std::unique_lock<std::mutex> lock { _results_mutex };
 
+  if ( _error ) {
+    std::rethrow_exception( _error );
+  }
+
   if ( _results.empty() )
     return 0;
 
@@ -0,0 +1,88 @@
+#include "transfer_local.hh"
+
+#include "util/lz4_frame.hh"
+
+using namespace std;
+
+LocalTransferAgent::LocalTransferAgent( const LocalStorageBackend& backend,
+                                        const size_t thread_count )
+  : TransferAgent()
+  , _root( backend.root() )
+{
+  _thread_count = thread_count;
+
+  if ( _thread_count == 0 ) {
+    throw runtime_error( "thread count cannot be zero" );
+  }
+
+  for ( size_t i = 0; i < _thread_count; i++ ) {
+    _threads.emplace_back( &LocalTransferAgent::worker_thread, this, i );
+  }
+}
+
+LocalTransferAgent::~LocalTransferAgent()
+{
+  {
+    unique_lock<mutex> lock { _outstanding_mutex };
+    _outstanding.emplace( _next_id++, Task::Terminate, "", "" );
+  }
+
+  _cv.notify_all();
+  for ( auto& t : _threads )
+    t.join();
+}
+
+void LocalTransferAgent::worker_thread( const size_t )
+{
+  while ( true ) {
+    optional<Action> action;
+
+    {
+      unique_lock<mutex> lock { _outstanding_mutex };
+      _cv.wait( lock, [this]() { return !_outstanding.empty(); } );
+
+      if ( _outstanding.front().task == Task::Terminate )
+        return;
+
+      action.emplace( move( _outstanding.front() ) );
+      _outstanding.pop();
+    }
+
+    string data;
+
+    /* an exception would end the program from this thread */
+    try {
+      switch ( action->task ) {
+        case Task::Download:
+          data = LocalStorageBackend::read_object( _root / action->key );
+
+          if ( lz4_frame::is_compressed( action->key ) ) {
+            data = lz4_frame::decompress( data );
+          }
+
+          break;
+
+        case Task::Upload:
+          LocalStorageBackend::write_object( action->data,
+                                             _root / action->key );
+          break;
+
+        default:
+          throw runtime_error( "Unknown action task" );
+      }
+    } catch ( const exception& e ) {
+      report_error( make_exception_ptr( runtime_error(
+        "local transfer of " + action->key + " failed: " + e.what() ) ) );
+      continue;
+    }
+
+    record_latency( *action );
+
+    {
+      unique_lock<mutex> lock { _results_mutex };
+      _results.emplace( action->id, move( data ) );
+    }
+
+    _event_fd.write_event();
+  }
+}
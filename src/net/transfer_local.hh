@@ -0,0 +1,20 @@
+#pragma once
+
+#include <filesystem>
+
+#include "storage/backend_local.hh"
+#include "transfer.hh"
+
+class LocalTransferAgent : public TransferAgent
+{
+protected:
+  const std::filesystem::path _root;
+
+  void worker_thread( const size_t thread_id ) override;
+
+public:
+  LocalTransferAgent( const LocalStorageBackend& backend,
+                      const size_t thread_count = MAX_THREADS );
+
+  ~LocalTransferAgent();
+};
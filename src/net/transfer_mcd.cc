@@ -73,7 +73,7 @@ void TransferAgent::worker_thread( const size_t )
                                            _loop.add_category( "Client Write" ),
                                            _loop.add_category( "Response" ) };
 
-  auto response_callback = [&actions, &pending_actions, &thread_results](
+  auto response_callback = [this, &actions, &pending_actions, &thread_results](
                              const size_t i, Response&& response ) {
     switch ( response.type() ) {
       case Response::Type::VALUE:
@@ -84,6 +84,7 @@ void TransferAgent::worker_thread( const size_t )
 
       case Response::Type::OK:
       case Response::Type::STORED:
+        record_latency( pending_actions[i].front() );
         thread_results.emplace( pending_actions[i].front().id,
                                 move( response.unstructured_data() ) );
         pending_actions[i].pop();
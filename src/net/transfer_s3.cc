@@ -1,6 +1,7 @@
 #include "transfer_s3.hh"
 
 #include "net/http_response_parser.hh"
+#include "util/lz4_frame.hh"
 
 using namespace std;
 using namespace chrono;
@@ -13,8 +14,8 @@ S3TransferAgent::S3Config::S3Config( const S3StorageBackend& backend )
   region = backend.client().config().region;
   bucket = backend.bucket();
   prefix = backend.prefix();
-  endpoint = S3::endpoint( region, bucket );
-  address.store( Address { endpoint, "http" } );
+  endpoint = backend.client().endpoint( bucket );
+  address.store( S3::address( endpoint, "http" ) );
 }
 
 S3TransferAgent::S3TransferAgent( const S3StorageBackend& backend,
@@ -54,7 +55,7 @@ HTTPRequest S3TransferAgent::get_request( const Action& action )
       return S3PutRequest( _client_config.credentials,
                            _client_config.endpoint,
                            _client_config.region,
-                           action.key,
+                           _client_config.prefix + action.key,
                            action.data,
                            UNSIGNED_PAYLOAD,
                            _upload_as_public )
@@ -64,7 +65,7 @@ HTTPRequest S3TransferAgent::get_request( const Action& action )
       return S3GetRequest( _client_config.credentials,
                            _client_config.endpoint,
                            _client_config.region,
-                           action.key )
+                           _client_config.prefix + action.key )
         .to_http_request();
 
     default:
@@ -98,6 +99,9 @@ void S3TransferAgent::worker_thread( const size_t thread_id )
     bool connection_okay = true;
     size_t request_count = 0;
 
+    /* one per request in flight; set for compressed objects only */
+    deque<unique_ptr<lz4_frame::Decoder>> decoders;
+
     if ( try_count > 0 ) {
       try_count = min<size_t>( try_count, 7u ); // caps at 3.2s
       this_thread::sleep_for( backoff * ( 1 << ( try_count - 1 ) ) );
@@ -133,7 +137,23 @@ void S3TransferAgent::worker_thread( const size_t thread_id )
       for ( const auto& action : actions ) {
         string headers;
         HTTPRequest request = get_request( action );
-        parser->new_request_arrived( request );
+
+        if ( action.task == Task::Download
+             and lz4_frame::is_compressed( action.key ) ) {
+          /* decompress the object as its body comes in */
+          auto decoder = decoders
+                           .emplace_back( make_unique<lz4_frame::Decoder>() )
+                           .get();
+
+          parser->new_request_arrived(
+            request, [decoder]( const string_view chunk ) {
+              decoder->decompress( chunk );
+            } );
+        } else {
+          decoders.emplace_back();
+          parser->new_request_arrived( request );
+        }
+
         request.serialize_headers( headers );
         TRY_OPERATION( s3.write_all( headers ), break );
 
@@ -159,15 +179,26 @@ void S3TransferAgent::worker_thread( const size_t thread_id )
           break;
         }
 
-        parser->parse( buffer_span.substr( 0, read_count ) );
+        /* a body that doesn't decompress counts as a failed download: the
+           connection is dropped, and what's left is requested again */
+        TRY_OPERATION( parser->parse( buffer_span.substr( 0, read_count ) ),
+                       break );
 
         while ( !parser->empty() ) {
           const string_view status = parser->front().status_code();
-          const string data = move( parser->front().body() );
+          string data = move( parser->front().body() );
+
+          auto decoder = move( decoders.front() );
+          decoders.pop_front();
+
+          if ( decoder and status[0] == '2' ) {
+            TRY_OPERATION( data = decoder->finish(), break );
+          }
 
           switch ( status[0] ) {
             case '2': // successful
             {
+              record_latency( actions.front() );
               unique_lock<mutex> lock { _results_mutex };
               _results.emplace( actions.front().id, move( data ) );
             }
@@ -201,7 +232,8 @@ void S3TransferAgent::worker_thread( const size_t thread_id )
 void S3TransferAgent::do_action( Action&& action )
 {
   if ( steady_clock::now() - _last_addr_update >= ADDR_UPDATE_INTERVAL ) {
-    _client_config.address.store( Address { _client_config.endpoint, "http" } );
+    _client_config.address.store(
+      S3::address( _client_config.endpoint, "http" ) );
     _last_addr_update = steady_clock::now();
   }
 
@@ -16,8 +16,10 @@ def handler(event, context):
     coordinator_address = event['coordinator']
     coordinator_host, coordinator_port = event['coordinator'].split(':')
 
-    # remove everything in the temp dir
-    print('rm -rf /tmp/*: {}'.format(os.system("rm -rf /tmp/*")))
+    # remove everything in the temp dir, except for the scene object cache
+    print('rm -rf /tmp/*: {}'.format(os.system(
+        "find /tmp -mindepth 1 -maxdepth 1 ! -name r2t2-cache "
+        "-exec rm -rf {} +")))
 
     command = ["r2t2-lambda-worker",
                "--ip", coordinator_host,
@@ -46,6 +48,9 @@ def handler(event, context):
     for server in event.get('memcachedServers', []):
         command += ['--memcached-server', server]
 
+    if event.get('sceneHash'):
+        command += ['--scene-hash', event['sceneHash']]
+
     print("$", " ".join(command))
 
     retcode = run_command(command)
@@ -20,6 +20,13 @@ optional<Schedule> AdaptiveScheduler::schedule(
       last_scheduled_at_ = steady_clock::now();
       stage_ = Stage::TWO;
       StaticScheduler static_scheduler { path_ };
+
+      /* we scale treelets down one by one, which groups don't allow */
+      if ( static_scheduler.grouped() ) {
+        throw runtime_error(
+          "adaptive scheduler doesn't support treelet grouping" );
+      }
+
       last_schedule_
         = *static_scheduler.schedule( max_workers, treelets, stats, n_paths );
       return last_schedule_;
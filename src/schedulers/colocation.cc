@@ -0,0 +1,128 @@
+#include "colocation.hh"
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+using namespace std;
+using namespace chrono;
+using namespace r2t2;
+
+constexpr seconds SCHEDULING_INTERVAL { 10 };
+
+/* pairs that carry less than this share of the traffic aren't worth the
+   memory of a second treelet */
+constexpr double MIN_TRAFFIC_SHARE = 0.05;
+
+CoLocationScheduler::CoLocationScheduler( const size_t max_treelets )
+  : max_treelets_per_worker( max_treelets )
+{}
+
+optional<Schedule> CoLocationScheduler::schedule(
+  const size_t maxWorkers,
+  const vector<TreeletStats>& treelets,
+  const WorkerStats& aggregated_stats,
+  const size_t total_paths )
+{
+  return uniform.schedule(
+    maxWorkers, treelets, aggregated_stats, total_paths );
+}
+
+optional<Plan> CoLocationScheduler::plan(
+  const size_t maxWorkers,
+  const vector<TreeletStats>& treelets,
+  const WorkerStats& aggregated_stats,
+  const size_t total_paths,
+  const vector<WorkerState>& workers,
+  const TransitionMatrix& transitions )
+{
+  /* the uniform schedule is only handed out once */
+  if ( auto initial = Scheduler::plan( maxWorkers,
+                                       treelets,
+                                       aggregated_stats,
+                                       total_paths,
+                                       workers,
+                                       transitions ) ) {
+    last_plan = steady_clock::now();
+    return initial;
+  }
+
+  if ( steady_clock::now() - last_plan < SCHEDULING_INTERVAL ) {
+    return nullopt;
+  }
+
+  last_plan = steady_clock::now();
+
+  /* workers that are still on their way would be left out */
+  vector<bool> covered( treelets.size(), false );
+
+  for ( const auto& worker : workers ) {
+    for ( const TreeletId tid : worker.treelets ) {
+      covered.at( tid ) = true;
+    }
+  }
+
+  if ( find( covered.begin(), covered.end(), false ) != covered.end() ) {
+    return nullopt;
+  }
+
+  const double total = transitions.total();
+  if ( total == 0 ) {
+    return nullopt;
+  }
+
+  map<pair<TreeletId, TreeletId>, double> affinities;
+
+  for ( const auto& [src, dst, weight] : transitions.entries() ) {
+    if ( src != dst ) {
+      affinities[minmax( src, dst )] += weight;
+    }
+  }
+
+  vector<pair<pair<TreeletId, TreeletId>, double>> pairs { affinities.begin(),
+                                                           affinities.end() };
+
+  sort( pairs.begin(), pairs.end(), []( const auto& a, const auto& b ) {
+    return a.second > b.second;
+  } );
+
+  /* what each worker has, including what we give it in this round */
+  map<WorkerId, set<TreeletId>> placed;
+
+  for ( const auto& worker : workers ) {
+    placed[worker.id].insert( worker.treelets.begin(), worker.treelets.end() );
+  }
+
+  Plan result;
+
+  for ( const auto& [treelet_pair, affinity] : pairs ) {
+    if ( affinity < MIN_TRAFFIC_SHARE * total ) {
+      break;
+    }
+
+    /* the workers of the sending side take on the receiving side */
+    auto [src, dst] = treelet_pair;
+    if ( transitions.weight( src, dst ) < transitions.weight( dst, src ) ) {
+      swap( src, dst );
+    }
+
+    for ( const auto& worker : workers ) {
+      auto& worker_treelets = placed[worker.id];
+
+      if ( not worker.active or worker_treelets.count( src ) == 0
+           or worker_treelets.count( dst ) > 0
+           or worker_treelets.size() >= max_treelets_per_worker ) {
+        continue;
+      }
+
+      result.push_back( { Placement::Action::Add, worker.id, dst } );
+      worker_treelets.insert( dst );
+    }
+  }
+
+  if ( result.empty() ) {
+    return nullopt;
+  }
+
+  return result;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <chrono>
+
+#include "scheduler.hh"
+#include "uniform.hh"
+
+namespace r2t2 {
+
+/* Starts out like the uniform scheduler. Once every treelet has its
+   workers, it looks at where the rays go and has the workers of a treelet
+   also load the treelet it sends the most rays to, so those rays can be
+   traced without leaving the worker. */
+class CoLocationScheduler : public Scheduler
+{
+private:
+  UniformScheduler uniform {};
+
+  size_t max_treelets_per_worker;
+  std::chrono::steady_clock::time_point last_plan {};
+
+public:
+  CoLocationScheduler( const size_t max_treelets_per_worker = 2 );
+
+  std::optional<Schedule> schedule( const size_t maxWorkers,
+                                    const std::vector<TreeletStats>& treelets,
+                                    const WorkerStats& aggregated_stats,
+                                    const size_t total_paths ) override;
+
+  std::optional<Plan> plan( const size_t maxWorkers,
+                            const std::vector<TreeletStats>& treelets,
+                            const WorkerStats& aggregated_stats,
+                            const size_t total_paths,
+                            const std::vector<WorkerState>& workers,
+                            const TransitionMatrix& transitions ) override;
+};
+
+} // namespace r2t2
@@ -0,0 +1,188 @@
+#include "queueing.hh"
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+
+#include "util/exception.hh"
+
+using namespace std;
+using namespace chrono;
+using namespace r2t2;
+
+/* gives the workers we moved around some time to settle in */
+constexpr seconds MIN_INTERVAL { 5 };
+
+/* how far ahead we account for rays that are yet to arrive */
+constexpr double HORIZON = 10.0;
+
+/* the share by which a new allocation has to beat the current one */
+constexpr double HYSTERESIS = 0.15;
+
+namespace {
+
+struct TreeletQueue
+{
+  double backlog { 0 };      /* bytes waiting to be traced */
+  double arrival_rate { 0 }; /* bytes per second */
+  double service_rate { 0 }; /* bytes per second, per worker */
+
+  double completion_time( const size_t workers ) const
+  {
+    const double work = backlog + arrival_rate * HORIZON;
+
+    if ( work == 0 ) {
+      return 0;
+    } else if ( workers == 0 ) {
+      return numeric_limits<double>::infinity();
+    }
+
+    return work / ( workers * service_rate );
+  }
+};
+
+double makespan( const vector<TreeletQueue>& queues, const Schedule& schedule )
+{
+  double result = 0;
+
+  for ( size_t tid = 0; tid < queues.size(); tid++ ) {
+    result = max( result, queues[tid].completion_time( schedule[tid] ) );
+  }
+
+  return result;
+}
+
+}
+
+optional<Schedule> QueueingScheduler::schedule(
+  const size_t maxWorkers,
+  const vector<TreeletStats>& treelets,
+  const WorkerStats&,
+  const size_t )
+{
+  const size_t treelet_count = treelets.size();
+
+  if ( maxWorkers < treelet_count ) {
+    throw runtime_error( "Not enough workers for queueing scheduler" );
+  }
+
+  /* we know nothing about the treelets yet, so everyone gets a fair share */
+  if ( not started_ ) {
+    started_ = true;
+    last_change_ = steady_clock::now();
+
+    current_.assign( treelet_count, maxWorkers / treelet_count );
+
+    for ( size_t i = 0; i < maxWorkers % treelet_count; i++ ) {
+      current_[i]++;
+    }
+
+    return current_;
+  }
+
+  if ( steady_clock::now() - last_change_ < MIN_INTERVAL ) {
+    return nullopt;
+  }
+
+  current_.resize( treelet_count, 0 );
+
+  /* (1) what does each treelet's queue look like? */
+  vector<TreeletQueue> queues( treelet_count );
+  double measured_rate = 0;
+  size_t measured_count = 0;
+
+  for ( size_t tid = 0; tid < treelet_count; tid++ ) {
+    const auto& stats = treelets[tid];
+    auto& queue = queues[tid];
+
+    if ( stats.enqueued.bytes > stats.dequeued.bytes ) {
+      queue.backlog = stats.enqueued.bytes - stats.dequeued.bytes;
+    }
+
+    queue.arrival_rate = stats.enqueue_rate;
+
+    if ( current_[tid] > 0 and stats.dequeue_rate > 0 ) {
+      queue.service_rate = 1.0 * stats.dequeue_rate / current_[tid];
+      measured_rate += queue.service_rate;
+      measured_count++;
+    }
+  }
+
+  if ( measured_count == 0 ) {
+    return nullopt;
+  }
+
+  /* treelets we haven't seen served are assumed to be average */
+  for ( auto& queue : queues ) {
+    if ( queue.service_rate == 0 ) {
+      queue.service_rate = measured_rate / measured_count;
+    }
+  }
+
+  /* (2) every treelet keeps a worker; the rest go, one at a time, to the
+     treelet that would take the longest to finish */
+  Schedule result( treelet_count, 1 );
+
+  auto slower = [&]( const TreeletId a, const TreeletId b ) {
+    return queues[a].completion_time( result[a] )
+           < queues[b].completion_time( result[b] );
+  };
+
+  priority_queue<TreeletId, vector<TreeletId>, decltype( slower )> slowest {
+    slower
+  };
+
+  for ( TreeletId tid = 0; tid < treelet_count; tid++ ) {
+    slowest.push( tid );
+  }
+
+  for ( size_t left = maxWorkers - treelet_count; left > 0; left-- ) {
+    const TreeletId tid = slowest.top();
+
+    if ( queues[tid].completion_time( result[tid] ) == 0 ) {
+      break; /* nobody has anything left to do */
+    }
+
+    slowest.pop();
+    result[tid]++;
+    slowest.push( tid );
+  }
+
+  /* (3) moving workers around isn't free; is it worth it? */
+  const double current_makespan = makespan( queues, current_ );
+  const double new_makespan = makespan( queues, result );
+
+  if ( result == current_
+       or new_makespan > ( 1 - HYSTERESIS ) * current_makespan ) {
+    return nullopt;
+  }
+
+  last_change_ = steady_clock::now();
+  current_ = result;
+  return result;
+}
+
+optional<Plan> QueueingScheduler::plan( const size_t maxWorkers,
+                                        const vector<TreeletStats>& treelets,
+                                        const WorkerStats& aggregated_stats,
+                                        const size_t total_paths,
+                                        const vector<WorkerState>& workers,
+                                        const TransitionMatrix& transitions )
+{
+  if ( started_ ) {
+    current_.assign( treelets.size(), 0 );
+
+    for ( const auto& worker : workers ) {
+      for ( const TreeletId tid : worker.treelets ) {
+        current_.at( tid )++;
+      }
+    }
+  }
+
+  return Scheduler::plan( maxWorkers,
+                          treelets,
+                          aggregated_stats,
+                          total_paths,
+                          workers,
+                          transitions );
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <chrono>
+
+#include "scheduler.hh"
+
+namespace r2t2 {
+
+/* Treats every treelet as a queue: bytes arrive at the treelet's enqueue
+   rate and each of its workers serves them at the rate the workers have
+   shown so far. Workers go to the treelets whose backlog would take the
+   longest to clear, and the allocation only changes when that brings the
+   expected completion time down by a good margin. */
+class QueueingScheduler : public Scheduler
+{
+private:
+  bool started_ { false };
+  std::chrono::steady_clock::time_point last_change_ {};
+
+  /* workers per treelet right now; plan() fills it in from the workers,
+     otherwise it's what we handed out last time */
+  Schedule current_ {};
+
+public:
+  std::optional<Schedule> schedule( const size_t maxWorkers,
+                                    const std::vector<TreeletStats>& treelets,
+                                    const WorkerStats& aggregated_stats,
+                                    const size_t total_paths ) override;
+
+  std::optional<Plan> plan( const size_t maxWorkers,
+                            const std::vector<TreeletStats>& treelets,
+                            const WorkerStats& aggregated_stats,
+                            const size_t total_paths,
+                            const std::vector<WorkerState>& workers,
+                            const TransitionMatrix& transitions ) override;
+};
+
+} // namespace r2t2
@@ -0,0 +1,99 @@
+#include "scheduler.hh"
+
+#include <algorithm>
+#include <deque>
+#include <numeric>
+#include <random>
+#include <set>
+#include <stdexcept>
+
+using namespace std;
+using namespace r2t2;
+
+optional<Plan> Scheduler::plan( const size_t maxWorkers,
+                                const vector<TreeletStats>& treelets,
+                                const WorkerStats& aggregated_stats,
+                                const size_t total_paths,
+                                const vector<WorkerState>& workers,
+                                const TransitionMatrix& )
+{
+  const auto opt_schedule
+    = schedule( maxWorkers, treelets, aggregated_stats, total_paths );
+
+  if ( not opt_schedule ) {
+    return nullopt;
+  }
+
+  const Schedule& requested = *opt_schedule;
+
+  /* is the schedule viable? */
+  if ( requested.size() != treelets.size() ) {
+    throw runtime_error( "invalid schedule" );
+  }
+
+  if ( accumulate( requested.begin(), requested.end(), 0ull ) > maxWorkers ) {
+    throw runtime_error( "not enough workers available for the schedule" );
+  }
+
+  vector<vector<const WorkerState*>> current( treelets.size() );
+
+  for ( const auto& worker : workers ) {
+    for ( const TreeletId tid : worker.treelets ) {
+      current.at( tid ).push_back( &worker );
+    }
+  }
+
+  vector<const WorkerState*> victims;
+  set<WorkerId> victim_ids;
+  deque<TreeletId> to_spawn;
+
+  for ( TreeletId tid = 0; tid < treelets.size(); tid++ ) {
+    auto& treelet_workers = current[tid];
+
+    if ( requested[tid] > treelet_workers.size() ) {
+      to_spawn.insert(
+        to_spawn.end(), requested[tid] - treelet_workers.size(), tid );
+    } else if ( requested[tid] < treelet_workers.size() ) {
+      /* the workers with the least outstanding work are the cheapest to
+         take away from this treelet */
+      sort( treelet_workers.begin(),
+            treelet_workers.end(),
+            []( const auto a, const auto b ) {
+              return a->outstanding_bytes < b->outstanding_bytes;
+            } );
+
+      const size_t surplus = treelet_workers.size() - requested[tid];
+
+      /* a worker with more than one treelet is taken away only once */
+      for ( size_t i = 0; i < surplus; i++ ) {
+        if ( victim_ids.insert( treelet_workers[i]->id ).second ) {
+          victims.push_back( treelet_workers[i] );
+        }
+      }
+    }
+  }
+
+  random_device rd {};
+  mt19937 g { rd() };
+  shuffle( to_spawn.begin(), to_spawn.end(), g );
+
+  Plan result;
+
+  for ( const auto victim : victims ) {
+    /* moving a worker is cheaper than draining it and invoking a new one,
+       which would download the whole scene again */
+    if ( victim->active and not to_spawn.empty() ) {
+      result.push_back(
+        { Placement::Action::Assign, victim->id, to_spawn.front() } );
+      to_spawn.pop_front();
+    } else {
+      result.push_back( { Placement::Action::Drain, victim->id, {} } );
+    }
+  }
+
+  for ( const TreeletId tid : to_spawn ) {
+    result.push_back( { Placement::Action::Spawn, {}, tid } );
+  }
+
+  return result;
+}
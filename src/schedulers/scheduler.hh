@@ -12,6 +12,43 @@ namespace r2t2 {
 /* Schedule is a {TreeletId -> Worker Count} mapping */
 using Schedule = std::vector<size_t>;
 
+/* what the scheduler gets to see of each tracer */
+struct WorkerState
+{
+  WorkerId id {};
+  std::vector<TreeletId> treelets {};
+
+  /* false while the worker is loading a treelet or finishing up */
+  bool active { true };
+
+  uint64_t outstanding_bytes { 0 };
+  uint64_t active_rays { 0 };
+  double cpu_usage { 0.0 };
+};
+
+/* a single change to where treelets live. Workers that aren't mentioned in
+   a plan keep their treelets. */
+struct Placement
+{
+  enum class Action
+  {
+    Keep,   /* leave `worker` as it is */
+    Assign, /* move `worker` over to `treelet`, dropping what it has */
+    Add,    /* have `worker` load `treelet` next to the ones it has */
+    Drain,  /* let `worker` finish its work and leave */
+    Spawn   /* start a new worker for `treelet` */
+  };
+
+  Action action { Action::Keep };
+  WorkerId worker {};
+  TreeletId treelet {};
+
+  /* other treelets a spawned worker loads along with `treelet` */
+  std::vector<TreeletId> group {};
+};
+
+using Plan = std::vector<Placement>;
+
 class Scheduler
 {
 public:
@@ -22,6 +59,17 @@ public:
     const size_t total_paths )
     = 0;
 
+  /* turns the schedule into placement actions. The default takes the
+     workers it needs to move from the treelets that have too many, least
+     loaded first, and reassigns them to the treelets that are short; the
+     ones that can't be moved are drained. */
+  virtual std::optional<Plan> plan( const size_t maxWorkers,
+                                    const std::vector<TreeletStats>& treelets,
+                                    const WorkerStats& aggregated_stats,
+                                    const size_t total_paths,
+                                    const std::vector<WorkerState>& workers,
+                                    const TransitionMatrix& transitions );
+
   virtual ~Scheduler() {}
 };
 
@@ -1,5 +1,6 @@
 #include "static.hh"
 
+#include <algorithm>
 #include <fstream>
 #include <numeric>
 #include <string>
@@ -17,32 +18,68 @@ StaticScheduler::StaticScheduler( const string& path )
     throw runtime_error( "static file was not found" );
   }
 
-  size_t treelet_count = 0;
-  fin >> treelet_count;
-  weights_.resize( treelet_count );
+  /* each line is a group: its weight, its size and its treelets */
+  size_t group_count = 0;
+  vector<bool> seen {};
 
-  for ( size_t i = 0; i < treelet_count; i++ ) {
+  fin >> group_count;
+  groups_.resize( group_count );
+  weights_.resize( group_count );
+
+  for ( size_t i = 0; i < group_count; i++ ) {
     size_t group_size = 0;
-    TreeletId id = 0;
     double prob = 0.f;
 
     fin >> prob >> group_size;
 
-    if ( group_size != 1 ) {
-      throw runtime_error(
-        "static scheduler doesn't support treelet grouping" );
+    if ( group_size == 0 ) {
+      throw runtime_error( "empty treelet group in static file" );
     }
 
-    fin >> id;
-    weights_[id] = prob;
+    weights_[i] = prob;
+    groups_[i].resize( group_size );
+
+    for ( auto& id : groups_[i] ) {
+      if ( not( fin >> id ) ) {
+        throw runtime_error( "malformed static file" );
+      }
+
+      if ( id >= seen.size() ) {
+        seen.resize( id + 1 );
+      }
+
+      if ( seen[id] ) {
+        throw runtime_error( "treelet " + to_string( id )
+                             + " appears twice in static file" );
+      }
+
+      seen[id] = true;
+    }
+  }
+
+  if ( not fin ) {
+    throw runtime_error( "malformed static file" );
+  }
+
+  /* every treelet up to the highest one has to be in a group */
+  const auto missing = find( seen.begin(), seen.end(), false );
+
+  if ( missing != seen.end() ) {
+    throw runtime_error( "treelet "
+                         + to_string( distance( seen.begin(), missing ) )
+                         + " is missing from static file" );
   }
+
+  treelet_count_ = seen.size();
 }
 
-Schedule StaticScheduler::get_schedule( size_t max_workers,
-                                        const size_t treelet_count ) const
+Schedule StaticScheduler::get_group_schedule( size_t max_workers,
+                                              const size_t treelet_count ) const
 {
-  if ( weights_.size() != treelet_count ) {
-    throw runtime_error( "weights_.size() != treelet_count" );
+  if ( treelet_count_ != treelet_count ) {
+    throw runtime_error( "static file has " + to_string( treelet_count_ )
+                         + " treelets, the scene has "
+                         + to_string( treelet_count ) );
   }
 
   valarray<double> weights = weights_;
@@ -71,6 +108,24 @@ Schedule StaticScheduler::get_schedule( size_t max_workers,
   return result;
 }
 
+Schedule StaticScheduler::get_schedule( size_t max_workers,
+                                        const size_t treelet_count ) const
+{
+  const Schedule group_schedule
+    = get_group_schedule( max_workers, treelet_count );
+
+  /* a worker counts toward every treelet of its group */
+  Schedule result( treelet_count, 0 );
+
+  for ( size_t i = 0; i < groups_.size(); i++ ) {
+    for ( const TreeletId id : groups_[i] ) {
+      result[id] = group_schedule[i];
+    }
+  }
+
+  return result;
+}
+
 optional<Schedule> StaticScheduler::schedule( const size_t max_workers,
                                               const vector<TreeletStats>& stats,
                                               const WorkerStats&,
@@ -83,3 +138,46 @@ optional<Schedule> StaticScheduler::schedule( const size_t max_workers,
   scheduled_once_ = true;
   return get_schedule( max_workers, stats.size() );
 }
+
+optional<Plan> StaticScheduler::plan( const size_t max_workers,
+                                      const vector<TreeletStats>& treelets,
+                                      const WorkerStats& aggregated_stats,
+                                      const size_t total_paths,
+                                      const vector<WorkerState>& workers,
+                                      const TransitionMatrix& transitions )
+{
+  if ( not grouped() ) {
+    return Scheduler::plan( max_workers,
+                            treelets,
+                            aggregated_stats,
+                            total_paths,
+                            workers,
+                            transitions );
+  }
+
+  if ( scheduled_once_ ) {
+    return nullopt;
+  }
+
+  scheduled_once_ = true;
+
+  /* the schedule is handed out before any worker is running, so we only
+     have to spawn them; each one loads its whole group */
+  const Schedule group_schedule
+    = get_group_schedule( max_workers, treelets.size() );
+
+  Plan result;
+
+  for ( size_t i = 0; i < groups_.size(); i++ ) {
+    const auto& group = groups_[i];
+
+    for ( size_t j = 0; j < group_schedule[i]; j++ ) {
+      result.push_back( { Placement::Action::Spawn,
+                          {},
+                          group.front(),
+                          { group.begin() + 1, group.end() } } );
+    }
+  }
+
+  return result;
+}
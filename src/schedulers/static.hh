@@ -12,16 +12,33 @@ private:
   bool scheduled_once_ { false };
 
 protected:
+  /* treelets that share a worker, and the weight of each group */
+  std::vector<std::vector<TreeletId>> groups_ {};
   std::valarray<double> weights_ {};
+  size_t treelet_count_ { 0 };
+
+  /* workers per group */
+  Schedule get_group_schedule( size_t max_workers,
+                               const size_t treelet_count ) const;
+
   Schedule get_schedule( size_t max_workers, const size_t treelet_count ) const;
 
 public:
   StaticScheduler( const std::string& path );
 
+  bool grouped() const { return groups_.size() != treelet_count_; }
+
   std::optional<Schedule> schedule( const size_t max_workers,
                                     const std::vector<TreeletStats>&,
                                     const WorkerStats&,
                                     const size_t ) override;
+
+  std::optional<Plan> plan( const size_t max_workers,
+                            const std::vector<TreeletStats>& treelets,
+                            const WorkerStats& aggregated_stats,
+                            const size_t total_paths,
+                            const std::vector<WorkerState>& workers,
+                            const TransitionMatrix& transitions ) override;
 };
 
 } // namespace r2t2
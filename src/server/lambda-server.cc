@@ -1,109 +1,432 @@
+/* Runs r2t2-lambda-worker processes on behalf of a master that was started
+   with --engine HOST:PORT. Every POST carries an InvocationPayload in JSON;
+   the response is sent when the worker exits, so the master knows the slot
+   is free again.
+
+   The server keeps a pool of warm workers: processes that have already
+   started (and, with --preload, fetched the base objects of a scene) and
+   are blocked on a control pipe. An invocation is written to the pipe of
+   an idle one, and the pool is topped up again. */
+
+#include <chrono>
+#include <csignal>
+#include <deque>
+#include <fcntl.h>
+#include <filesystem>
+#include <getopt.h>
 #include <iostream>
-#include <memory>
+#include <list>
+#include <map>
+#include <optional>
 #include <string>
 #include <vector>
 
-#include "execution/loop.hh"
+#include "common/invocation.hh"
 #include "messages/utils.hh"
 #include "net/http_request_parser.hh"
+#include "net/http_response.hh"
+#include "net/socket.hh"
+#include "util/child_process.hh"
+#include "util/eventloop.hh"
 #include "util/exception.hh"
+#include "util/pipe.hh"
+#include "util/signalfd.hh"
 #include "util/system_runner.hh"
 
 using namespace std;
+using namespace chrono;
 using namespace r2t2;
 
+/* keeps the server's own descriptors out of the workers it starts */
+void set_cloexec( FileDescriptor& fd )
+{
+  SystemCall( "fcntl", fcntl( fd.fd_num(), F_SETFD, FD_CLOEXEC ) );
+}
+
+class LambdaServer
+{
+private:
+  struct Job
+  {
+    optional<ChildProcess> worker {};
+    optional<string> status {};
+    string result {};
+  };
+
+  struct Connection
+  {
+    TCPSocket socket;
+    HTTPRequestParser requests {};
+    deque<Job> jobs {};
+    optional<EventLoop::RuleHandle> rule {};
+
+    Connection( TCPSocket&& s )
+      : socket( move( s ) )
+    {}
+  };
+
+  struct WarmWorker
+  {
+    ChildProcess process;
+    FileDescriptor control;
+  };
+
+  const string worker_program;
+  const size_t pool_size;
+  const string preload_uri;
+
+  list<WarmWorker> pool {};
+
+  EventLoop loop {};
+  SignalMask signals { SIGCHLD, SIGHUP, SIGTERM, SIGQUIT, SIGINT };
+  SignalFD signal_fd { signals };
+
+  TCPSocket listener {};
+
+  uint64_t next_connection_id { 0 };
+  map<uint64_t, Connection> connections {};
+
+  string read_buffer = string( 64 * 1024, '\0' );
+
+  void refill_pool();
+  optional<ChildProcess> take_warm_worker( const string& payload );
+
+  void start_job( Connection& connection, const HTTPRequest& request );
+  void send_finished( Connection& connection );
+  void close_connection( const uint64_t connection_id );
+  void handle_worker_exits();
+
+public:
+  LambdaServer( const Address& listen_address,
+                const string& worker_program,
+                const size_t pool_size,
+                const string& preload_uri );
+
+  void run();
+};
+
+LambdaServer::LambdaServer( const Address& listen_address,
+                            const string& worker_program_,
+                            const size_t pool_size_,
+                            const string& preload_uri_ )
+  : worker_program( worker_program_ )
+  , pool_size( pool_size_ )
+  , preload_uri( preload_uri_ )
+{
+  signals.set_as_mask();
+
+  set_cloexec( listener );
+  listener.set_blocking( false );
+  listener.set_reuseaddr();
+  listener.bind( listen_address );
+  listener.listen( 128 );
+
+  loop.add_rule(
+    "Signals",
+    Direction::In,
+    signal_fd,
+    [this] {
+      const auto sig = signal_fd.read_signal();
+
+      if ( sig.ssi_signo == SIGCHLD ) {
+        handle_worker_exits();
+      } else {
+        throw runtime_error( "interrupted by signal" );
+      }
+    },
+    [] { return true; } );
+
+  loop.add_rule(
+    "Listener",
+    Direction::In,
+    listener,
+    [this] {
+      const uint64_t connection_id = next_connection_id++;
+      auto& connection
+        = connections.emplace( connection_id, listener.accept() )
+            .first->second;
+
+      set_cloexec( connection.socket );
+
+      cerr << "incoming connection from "
+           << connection.socket.peer_address().to_string() << endl;
+
+      connection.rule = loop.add_rule(
+        "Connection",
+        Direction::In,
+        connection.socket,
+        [this, connection_id] {
+          auto& conn = connections.at( connection_id );
+          simple_string_span buffer { read_buffer };
+
+          const size_t read_count = conn.socket.read( buffer );
+          if ( read_count == 0 ) {
+            close_connection( connection_id );
+            return;
+          }
+
+          conn.requests.parse( buffer.substr( 0, read_count ) );
+
+          while ( not conn.requests.empty() ) {
+            start_job( conn, conn.requests.front() );
+            conn.requests.pop();
+          }
+
+          send_finished( conn );
+        },
+        [] { return true; },
+        [this, connection_id] { close_connection( connection_id ); } );
+    },
+    [] { return true; } );
+
+  cerr << "\u2192 Listening for invocations on "
+       << listener.local_address().to_string() << endl;
+
+  refill_pool();
+}
+
+void LambdaServer::refill_pool()
+{
+  while ( pool.size() < pool_size ) {
+    auto [control_read, control_write] = make_pipe();
+    set_cloexec( control_write );
+
+    vector<string> command { worker_program,
+                             "--control-fd",
+                             to_string( control_read.fd_num() ) };
+
+    if ( not preload_uri.empty() ) {
+      command.insert( command.end(), { "--preload", preload_uri } );
+    }
+
+    pool.push_back( { ChildProcess { "r2t2-lambda-worker",
+                                     [&command] {
+                                       return ezexec(
+                                         command[0], command, {}, true, true );
+                                     } },
+                      move( control_write ) } );
+  }
+}
+
+optional<ChildProcess> LambdaServer::take_warm_worker( const string& payload )
+{
+  while ( not pool.empty() ) {
+    WarmWorker worker = move( pool.front() );
+    pool.pop_front();
+
+    try {
+      /* the worker reads up to EOF, i.e. until `control` goes away */
+      worker.control.write_all( payload );
+      return move( worker.process );
+    } catch ( const exception& ex ) {
+      cerr << "warm worker " << worker.process.pid()
+           << " is gone: " << ex.what() << endl;
+    }
+  }
+
+  return nullopt;
+}
+
+void LambdaServer::start_job( Connection& connection,
+                              const HTTPRequest& request )
+{
+  Job& job = connection.jobs.emplace_back();
+
+  try {
+    protobuf::InvocationPayload payload;
+    protoutil::from_json( request.body(), payload );
+
+    payload.set_invoked_at(
+      duration_cast<microseconds>( system_clock::now().time_since_epoch() )
+        .count() );
+
+    if ( auto warm_worker
+         = take_warm_worker( protoutil::to_json( payload ) ) ) {
+      cerr << "handing invocation to warm worker " << warm_worker->pid()
+           << endl;
+
+      job.worker.emplace( move( *warm_worker ) );
+      refill_pool();
+    } else {
+      const auto command = worker_command( payload, worker_program );
+      cerr << "$ " << command_str( command, {} ) << endl;
+
+      job.worker.emplace( "r2t2-lambda-worker", [&command] {
+        return ezexec( command[0], command, {}, true, true );
+      } );
+    }
+  } catch ( const exception& ex ) {
+    job.status = "HTTP/1.1 400 Bad Request";
+    job.result = ex.what();
+  }
+}
+
+void LambdaServer::send_finished( Connection& connection )
+{
+  string headers;
+
+  /* responses go out in the order the requests came in */
+  while ( not connection.jobs.empty() and connection.jobs.front().status ) {
+    Job& job = connection.jobs.front();
+
+    HTTPResponse response {
+      move( *job.status ),
+      { { "Content-Length", to_string( job.result.length() ) } },
+      move( job.result )
+    };
+
+    response.serialize_headers( headers );
+    connection.socket.write_all( headers );
+    connection.socket.write_all( response.body() );
+
+    connection.jobs.pop_front();
+  }
+}
+
+void LambdaServer::close_connection( const uint64_t connection_id )
+{
+  auto it = connections.find( connection_id );
+  if ( it == connections.end() ) {
+    return;
+  }
+
+  /* the master went away; its running workers are killed along with it */
+  if ( it->second.rule ) {
+    it->second.rule->cancel();
+  }
+
+  connections.erase( it );
+  cerr << "connection closed." << endl;
+}
+
+void LambdaServer::handle_worker_exits()
+{
+  /* warm workers shouldn't exit before they're used; don't respawn them
+     here, or a broken preload would have us fork in a loop */
+  for ( auto it = pool.begin(); it != pool.end(); ) {
+    if ( it->process.waitable() ) {
+      it->process.wait( true );
+    }
+
+    if ( it->process.terminated() ) {
+      cerr << "warm worker " << it->process.pid() << " exited with status "
+           << it->process.exit_status() << endl;
+      it = pool.erase( it );
+    } else {
+      it++;
+    }
+  }
+
+  for ( auto& [connection_id, connection] : connections ) {
+    for ( auto& job : connection.jobs ) {
+      if ( not job.worker or job.status ) {
+        continue;
+      }
+
+      if ( job.worker->waitable() ) {
+        job.worker->wait( true );
+      }
+
+      if ( job.worker->terminated() ) {
+        cerr << "worker " << job.worker->pid() << " exited with status "
+             << job.worker->exit_status() << endl;
+
+        job.status = "HTTP/1.1 200 OK";
+        job.result = to_string( job.worker->exit_status() );
+      }
+    }
+
+    send_finished( connection );
+  }
+}
+
+void LambdaServer::run()
+{
+  while ( loop.wait_next_event( -1 ) != EventLoop::Result::Exit ) {
+    continue;
+  }
+}
+
 void usage( char const* argv0 )
 {
-  cerr << "Usage: " << argv0 << " IP PORT" << endl;
+  cerr << "Usage: " << argv0 << " [OPTIONS] IP PORT" << endl
+       << endl
+       << "Options:" << endl
+       << "  -w --worker PATH           r2t2-lambda-worker binary" << endl
+       << "  -n --pool-size N           number of warm workers (default: 4)"
+       << endl
+       << "  -P --preload NAME          storage backend whose base scene"
+       << endl
+       << "                             objects warm workers load ahead"
+       << endl
+       << "  -h --help                  show help information" << endl;
 }
 
-int main( int argc, char const* argv[] )
+int main( int argc, char* argv[] )
 {
   try {
     if ( argc <= 0 ) {
       abort();
     }
 
-    if ( argc != 3 ) {
-      usage( argv[0] );
-      return EXIT_FAILURE;
+    /* prefer the worker binary that was built next to this one */
+    string worker_program = "r2t2-lambda-worker";
+    size_t pool_size = 4;
+    string preload_uri;
+
+    const auto sibling
+      = filesystem::read_symlink( "/proc/self/exe" ).parent_path()
+        / worker_program;
+
+    if ( filesystem::exists( sibling ) ) {
+      worker_program = sibling.string();
     }
 
-    string host = argv[1];
-    uint16_t port = static_cast<uint16_t>( stoi( argv[2] ) );
-
-    Address listenAddr { host, port };
-    ExecutionLoop loop;
-
-    loop.make_listener(
-      listenAddr, []( ExecutionLoop& loop, TCPSocket&& socket ) {
-        auto parser = make_shared<HTTPRequestParser>();
-
-        cerr << "incoming connection from " << socket.peer_address().str()
-             << endl;
-
-        loop.add_connection<TCPSocket>(
-          move( socket ),
-          [parser, &loop]( shared_ptr<TCPConnection> connection,
-                           string&& data ) {
-            parser->parse( move( data ) );
-
-            while ( !parser->empty() ) {
-              HTTPRequest request { move( parser->front() ) };
-              parser->pop();
-
-              cerr << request.first_line() << endl;
-
-              protobuf::InvocationPayload payload;
-              protoutil::from_json( request.body(), payload );
-
-              loop.add_child_process(
-                "lambda-worker",
-                []( const uint64_t, const string&, const int status ) {},
-                [payload]() -> int {
-                  auto masterAddr = Address::decompose( payload.coordinator() );
-
-                  vector<string> command { "r2t2-lambda-worker",
-                                           "--ip",
-                                           masterAddr.first,
-                                           "--port",
-                                           to_string( masterAddr.second ),
-                                           "--storage-backend",
-                                           payload.storage_backend(),
-                                           "--samples",
-                                           to_string(
-                                             payload.samples_per_pixel() ) };
-
-                  return ezexec( command[0], command, {}, true, true );
-                } );
-
-              /* send back a response */
-              HTTPResponse response;
-              response.set_request( request );
-              response.set_first_line( "HTTP/1.1 200 OK" );
-              response.add_header( HTTPHeader { "Content-Length", "0" } );
-              response.done_with_headers();
-              response.read_in_body( "" );
-              connection->enqueue_write( response.str() );
-            }
-
-            return true;
-          },
-          []() { throw runtime_error( "error" ); },
-          []() { cerr << "connection closed." << endl; } );
-
-        return true; /* continue listening */
-      } );
+    struct option long_options[] = {
+      { "worker", required_argument, nullptr, 'w' },
+      { "pool-size", required_argument, nullptr, 'n' },
+      { "preload", required_argument, nullptr, 'P' },
+      { "help", no_argument, nullptr, 'h' },
+      { nullptr, 0, nullptr, 0 },
+    };
 
     while ( true ) {
-      auto res = loop.loop_once().result;
-      if ( res != Poller::Result::Type::Success
-           && res != Poller::Result::Type::Timeout )
+      const int opt
+        = getopt_long( argc, argv, "w:n:P:h", long_options, nullptr );
+
+      if ( opt == -1 ) {
         break;
+      }
+
+      // clang-format off
+      switch ( opt ) {
+      case 'w': worker_program = optarg; break;
+      case 'n': pool_size = stoul( optarg ); break;
+      case 'P': preload_uri = optarg; break;
+      case 'h': usage( argv[0] ); return EXIT_SUCCESS;
+      default: usage( argv[0] ); return EXIT_FAILURE;
+      }
+      // clang-format on
     }
 
+    if ( optind + 2 != argc ) {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+
+    const string host = argv[optind];
+    const uint16_t port = static_cast<uint16_t>( stoi( argv[optind + 1] ) );
+
+    /* a master hanging up shouldn't take the server down */
+    signal( SIGPIPE, SIG_IGN );
+
+    LambdaServer server {
+      { host, port }, worker_program, pool_size, preload_uri
+    };
+
+    server.run();
   } catch ( exception& ex ) {
-    print_exception( "lambda-worker", ex );
+    print_exception( "lambda-server", ex );
     return EXIT_FAILURE;
   }
 
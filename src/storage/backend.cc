@@ -13,7 +13,9 @@
 
 using namespace std;
 
-unique_ptr<StorageBackend> StorageBackend::create_backend( const string& uri )
+unique_ptr<StorageBackend> StorageBackend::create_backend(
+  const string& uri,
+  const bool bucket_root )
 {
   ParsedURI endpoint { uri };
 
@@ -27,12 +29,19 @@ unique_ptr<StorageBackend> StorageBackend::create_backend( const string& uri )
       endpoint.host,
       endpoint.options.count( "region" ) ? endpoint.options["region"]
                                          : "us-east-1",
-      endpoint.path );
+      bucket_root ? "" : endpoint.path,
+      endpoint.options.count( "endpoint" ) ? endpoint.options["endpoint"]
+                                           : "" );
   } else if ( endpoint.protocol == "gs" ) {
     backend = make_unique<GoogleStorageBackend>(
       AWSCredentials { endpoint.username, endpoint.password },
       endpoint.host,
-      endpoint.path );
+      bucket_root ? "" : endpoint.path );
+  } else if ( endpoint.protocol == "file" ) {
+    /* file:///abs/path has no host, file://rel/path is relative */
+    backend = make_unique<LocalStorageBackend>(
+      endpoint.host.empty() ? "/" + endpoint.path
+                            : endpoint.host + "/" + endpoint.path );
   } else {
     throw runtime_error( "unknown storage backend" );
   }
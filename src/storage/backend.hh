@@ -25,8 +25,11 @@ public:
     const GetCallback& success_callback = []( const storage::GetRequest& ) {} )
     = 0;
 
+  /* with bucket_root set, the path in the URI is ignored for s3:// and gs://
+     backends; for file:// backends the path is always the root */
   static std::unique_ptr<StorageBackend> create_backend(
-    const std::string& uri );
+    const std::string& uri,
+    const bool bucket_root = false );
 
   virtual ~StorageBackend() {}
 };
@@ -0,0 +1,126 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "backend_local.hh"
+
+#include <fcntl.h>
+#include <functional>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "util/exception.hh"
+#include "util/file_descriptor.hh"
+#include "util/fileutils.hh"
+#include "util/ring_buffer.hh"
+
+using namespace std;
+using namespace storage;
+
+namespace {
+
+/* opens an object, making sure it's a regular file; returns its length */
+pair<FileDescriptor, size_t> open_object( const filesystem::path& path )
+{
+  FileDescriptor file { SystemCall( "open (" + path.string() + ")",
+                                    open( path.c_str(), O_RDONLY ) ) };
+
+  struct stat file_info;
+  SystemCall( "fstat", fstat( file.fd_num(), &file_info ) );
+
+  if ( not S_ISREG( file_info.st_mode ) ) {
+    throw runtime_error( path.string() + " is not a regular file" );
+  }
+
+  return { move( file ), static_cast<size_t>( file_info.st_size ) };
+}
+
+void with_mapped_file( const filesystem::path& path,
+                       const function<void( const string_view )>& callback )
+{
+  auto [file, length] = open_object( path );
+
+  if ( length == 0 ) {
+    callback( {} );
+    return;
+  }
+
+  MMap_Region region { nullptr,
+                       length,
+                       PROT_READ,
+                       MAP_PRIVATE | MAP_POPULATE,
+                       file.fd_num() };
+
+  madvise( region.addr(), length, MADV_SEQUENTIAL );
+  callback( { region.addr(), length } );
+}
+
+}
+
+LocalStorageBackend::LocalStorageBackend( const filesystem::path& root )
+  : root_( root )
+{
+  filesystem::create_directories( root_ );
+}
+
+MMap_Region LocalStorageBackend::map_object( const filesystem::path& path )
+{
+  auto [file, length] = open_object( path );
+
+  if ( length == 0 ) {
+    throw runtime_error( path.string() + " is empty" );
+  }
+
+  /* private and writable, so that the reader may patch it up in place */
+  return {
+    nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, file.fd_num()
+  };
+}
+
+string LocalStorageBackend::read_object( const filesystem::path& path )
+{
+  string contents;
+  with_mapped_file( path, [&contents]( const string_view data ) {
+    contents.assign( data.data(), data.length() );
+  } );
+
+  return contents;
+}
+
+void LocalStorageBackend::write_object( const string_view contents,
+                                        const filesystem::path& path,
+                                        const bool set_mode,
+                                        const mode_t target_mode )
+{
+  if ( path.has_parent_path() ) {
+    filesystem::create_directories( path.parent_path() );
+  }
+
+  roost::atomic_create( contents, path, set_mode, target_mode );
+}
+
+void LocalStorageBackend::put( const vector<PutRequest>& requests,
+                               const PutCallback& success_callback )
+{
+  for ( const auto& request : requests ) {
+    with_mapped_file( request.filename, [&]( const string_view data ) {
+      write_object( data, root_ / request.object_key );
+    } );
+
+    success_callback( request );
+  }
+}
+
+void LocalStorageBackend::get( const vector<GetRequest>& requests,
+                               const GetCallback& success_callback )
+{
+  for ( const auto& request : requests ) {
+    with_mapped_file(
+      root_ / request.object_key, [&]( const string_view data ) {
+        write_object( data,
+                      request.filename,
+                      request.mode.has_value(),
+                      request.mode.value_or( 0 ) );
+      } );
+
+    success_callback( request );
+  }
+}
@@ -2,22 +2,44 @@
 
 #pragma once
 
+#include <filesystem>
+#include <string>
+#include <string_view>
+
 #include "backend.hh"
-#include "net/aws.hh"
-#include "net/s3.hh"
+#include "util/ring_buffer.hh"
 
+/* stores objects as files under a root directory (file:// URIs) */
 class LocalStorageBackend : public StorageBackend
 {
+private:
+  std::filesystem::path root_;
+
 public:
-  LocalStorageBackend() {}
+  LocalStorageBackend( const std::filesystem::path& root );
 
   void put(
-    const std::vector<storage::PutRequest>&,
-    const PutCallback& = []( const storage::PutRequest& ) {} )
-  {}
+    const std::vector<storage::PutRequest>& requests,
+    const PutCallback& success_callback
+    = []( const storage::PutRequest& ) {} ) override;
 
   void get(
-    const std::vector<storage::GetRequest>&,
-    const GetCallback& = []( const storage::GetRequest& ) {} )
-  {}
+    const std::vector<storage::GetRequest>& requests,
+    const GetCallback& success_callback
+    = []( const storage::GetRequest& ) {} ) override;
+
+  const std::filesystem::path& root() const { return root_; }
+
+  /* objects are mmapped and copied out in one pass */
+  static std::string read_object( const std::filesystem::path& path );
+
+  /* maps a (non-empty) object copy-on-write, so that it can be read
+     without copying it into the heap first */
+  static MMap_Region map_object( const std::filesystem::path& path );
+
+  /* written to a temporary file and renamed into place */
+  static void write_object( const std::string_view contents,
+                            const std::filesystem::path& path,
+                            const bool set_mode = false,
+                            const mode_t target_mode = 0 );
 };
@@ -8,8 +8,9 @@ using namespace storage;
 S3StorageBackend::S3StorageBackend( const AWSCredentials& credentials,
                                     const string& s3_bucket,
                                     const string& s3_region,
-                                    const string& prefix )
-  : client_( credentials, { s3_region } )
+                                    const string& prefix,
+                                    const string& endpoint )
+  : client_( credentials, { s3_region, endpoint, 32, 32, endpoint.empty() } )
   , bucket_( s3_bucket )
   , prefix_( prefix )
 {
@@ -17,7 +17,8 @@ public:
   S3StorageBackend( const AWSCredentials& credentials,
                     const std::string& s3_bucket,
                     const std::string& s3_region,
-                    const std::string& prefix = {} );
+                    const std::string& prefix = {},
+                    const std::string& endpoint = {} );
 
   void put(
     const std::vector<storage::PutRequest>& requests,
@@ -0,0 +1,154 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "object_cache.hh"
+
+#include <algorithm>
+#include <iostream>
+#include <system_error>
+#include <vector>
+
+#include "storage/backend_local.hh"
+#include "util/digest.hh"
+
+using namespace std;
+
+ObjectCache::ObjectCache( const filesystem::path& root,
+                          const uint64_t capacity,
+                          const string& scene_hash )
+  : root_( root )
+  , capacity_( capacity )
+  , scene_hash_( scene_hash )
+{
+  filesystem::create_directories( root_ );
+}
+
+filesystem::path ObjectCache::entry_path( const string& name ) const
+{
+  return root_ / digest::sha256_base58( scene_hash_ + "/" + name );
+}
+
+void ObjectCache::record_hit( const filesystem::path& path,
+                              const uint64_t length )
+{
+  /* a hit makes this the most recently used entry */
+  error_code ec;
+  filesystem::last_write_time(
+    path, filesystem::file_time_type::clock::now(), ec );
+
+  stats_.hits++;
+  stats_.bytes_saved += length;
+}
+
+optional<string> ObjectCache::get( const string& name )
+{
+  const auto path = entry_path( name );
+  error_code ec;
+
+  if ( filesystem::exists( path, ec ) ) {
+    try {
+      string contents = LocalStorageBackend::read_object( path );
+      record_hit( path, contents.length() );
+      return contents;
+    } catch ( const exception& ) {
+      /* another worker evicted it in the meantime */
+    }
+  }
+
+  stats_.misses++;
+  return nullopt;
+}
+
+optional<MMap_Region> ObjectCache::map( const string& name )
+{
+  const auto path = entry_path( name );
+  error_code ec;
+
+  if ( filesystem::exists( path, ec ) ) {
+    try {
+      /* the mapping stays valid even if the entry is evicted later */
+      MMap_Region region = LocalStorageBackend::map_object( path );
+      record_hit( path, region.length() );
+      return region;
+    } catch ( const exception& ) {
+      /* another worker evicted it in the meantime */
+    }
+  }
+
+  stats_.misses++;
+  return nullopt;
+}
+
+void ObjectCache::put( const string& name, const string_view contents )
+{
+  if ( contents.length() > capacity_ ) {
+    return;
+  }
+
+  /* the cache is only an optimization; a full disk shouldn't fail the job */
+  try {
+    LocalStorageBackend::write_object( contents, entry_path( name ) );
+
+    if ( not size_ or ( *size_ += contents.length() ) > capacity_ ) {
+      evict();
+    }
+  } catch ( const exception& ex ) {
+    cerr << "object cache: " << ex.what() << endl;
+  }
+}
+
+void ObjectCache::evict()
+{
+  struct Entry
+  {
+    filesystem::file_time_type last_used;
+    uint64_t size;
+    filesystem::path path;
+  };
+
+  vector<Entry> entries;
+  uint64_t total_size = 0;
+  error_code ec;
+
+  for ( const auto& entry : filesystem::directory_iterator( root_ ) ) {
+    /* files that are still being written have a temporary suffix */
+    if ( entry.path().has_extension() or not entry.is_regular_file( ec ) ) {
+      continue;
+    }
+
+    const auto size = entry.file_size( ec );
+    if ( ec ) {
+      continue;
+    }
+
+    const auto last_used = entry.last_write_time( ec );
+    if ( ec ) {
+      continue;
+    }
+
+    entries.push_back( { last_used, size, entry.path() } );
+    total_size += size;
+  }
+
+  size_ = total_size;
+
+  if ( total_size <= capacity_ ) {
+    return;
+  }
+
+  const auto target = static_cast<uint64_t>( EVICT_TO * capacity_ );
+
+  sort( entries.begin(), entries.end(), []( const auto& a, const auto& b ) {
+    return a.last_used < b.last_used;
+  } );
+
+  for ( const auto& entry : entries ) {
+    if ( total_size <= target ) {
+      break;
+    }
+
+    filesystem::remove( entry.path, ec );
+    total_size -= entry.size;
+  }
+
+  size_ = total_size;
+}
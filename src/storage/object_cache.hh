@@ -0,0 +1,61 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "util/ring_buffer.hh"
+
+/* A size-bounded cache of scene objects on local disk. It outlives the
+   worker that fills it, so later jobs on the same machine (or the same warm
+   Lambda container) can skip the download. Entries are addressed by the
+   scene hash and the object name; the least recently used ones go first
+   when the cache grows past its capacity. Several workers may share the
+   directory: entries are renamed into place, and recency is the mtime. */
+class ObjectCache
+{
+public:
+  struct Stats
+  {
+    uint64_t hits { 0 };
+    uint64_t misses { 0 };
+    uint64_t bytes_saved { 0 };
+  };
+
+private:
+  std::filesystem::path root_;
+  uint64_t capacity_;
+  std::string scene_hash_;
+  Stats stats_ {};
+
+  /* the size of the directory at the last scan, plus what we put since;
+     writes by other workers show up at the next scan */
+  std::optional<uint64_t> size_ {};
+
+  std::filesystem::path entry_path( const std::string& name ) const;
+  void record_hit( const std::filesystem::path& path, const uint64_t length );
+
+  /* scans the directory and, if the cache is over capacity, drops the least
+     recently used entries until it's below EVICT_TO of it, so that the next
+     scan is a while away */
+  static constexpr double EVICT_TO = 0.9;
+  void evict();
+
+public:
+  ObjectCache( const std::filesystem::path& root,
+               const uint64_t capacity,
+               const std::string& scene_hash );
+
+  std::optional<std::string> get( const std::string& name );
+
+  /* like get(), but maps the entry instead of reading it */
+  std::optional<MMap_Region> map( const std::string& name );
+
+  void put( const std::string& name, const std::string_view contents );
+
+  const Stats& stats() const { return stats_; }
+};
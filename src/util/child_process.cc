@@ -3,6 +3,8 @@
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
+#include <fcntl.h>
+#include <spawn.h>
 #include <string>
 #include <sys/stat.h>
 #include <sys/syscall.h>
@@ -38,6 +40,69 @@ int do_fork()
   return SystemCall( "fork", fork() );
 }
 
+pid_t do_spawn( const vector<string>& command, const bool quiet )
+{
+  if ( command.empty() ) {
+    throw runtime_error( "spawn: empty command" );
+  }
+
+  /* posix_spawn* return an error number instead of setting errno */
+  auto check = []( const char* attempt, const int error ) {
+    if ( error ) {
+      throw unix_error( attempt, error );
+    }
+  };
+
+  vector<char*> argv;
+
+  for ( const auto& arg : command ) {
+    argv.push_back( const_cast<char*>( arg.c_str() ) );
+  }
+
+  argv.push_back( nullptr );
+
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attributes;
+
+  check( "posix_spawn_file_actions_init",
+         posix_spawn_file_actions_init( &actions ) );
+  check( "posix_spawnattr_init", posix_spawnattr_init( &attributes ) );
+
+  pid_t pid;
+  int error = 0;
+
+  /* like the forked children, start with no signals blocked */
+  sigset_t no_signals;
+  sigemptyset( &no_signals );
+
+  error = posix_spawnattr_setsigmask( &attributes, &no_signals );
+
+  if ( not error ) {
+    error = posix_spawnattr_setflags( &attributes, POSIX_SPAWN_SETSIGMASK );
+  }
+
+  if ( not error and quiet ) {
+    error = posix_spawn_file_actions_addopen(
+      &actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0 );
+  }
+
+  if ( not error and quiet ) {
+    error = posix_spawn_file_actions_adddup2(
+      &actions, STDOUT_FILENO, STDERR_FILENO );
+  }
+
+  if ( not error ) {
+    error = posix_spawnp(
+      &pid, argv[0], &actions, &attributes, argv.data(), environ );
+  }
+
+  posix_spawn_file_actions_destroy( &actions );
+  posix_spawnattr_destroy( &attributes );
+
+  check( "posix_spawnp", error );
+  return pid;
+}
+
 /* start up a child process running the supplied lambda */
 /* the return value of the lambda is the child's exit status */
 ChildProcess::ChildProcess( const string& name,
@@ -63,6 +128,20 @@ ChildProcess::ChildProcess( const string& name,
   }
 }
 
+ChildProcess::ChildProcess( const string& name,
+                            const vector<string>& command,
+                            const bool quiet,
+                            const int termination_signal )
+  : name_( name )
+  , pid_( do_spawn( command, quiet ) )
+  , running_( true )
+  , terminated_( false )
+  , exit_status_()
+  , died_on_signal_( false )
+  , graceful_termination_signal_( termination_signal )
+  , moved_away_( false )
+{}
+
 /* is process in a waitable state? */
 bool ChildProcess::waitable( void ) const
 {
@@ -5,7 +5,9 @@
 #include <cassert>
 #include <csignal>
 #include <functional>
+#include <string>
 #include <unistd.h>
+#include <vector>
 
 /* object-oriented wrapper for handling Unix child processes */
 
@@ -26,6 +28,14 @@ public:
                 std::function<int()>&& child_procedure,
                 const int termination_signal = SIGHUP );
 
+  /* runs `command` (searched for in PATH) with posix_spawn, which, unlike
+     fork, is fine in a program that has other threads; with `quiet`, its
+     output goes to /dev/null */
+  ChildProcess( const std::string& name,
+                const std::vector<std::string>& command,
+                const bool quiet,
+                const int termination_signal = SIGHUP );
+
   bool waitable( void ) const; /* is process in a waitable state? */
   void wait( const bool nonblocking
              = false );         /* wait for process to change state */
@@ -0,0 +1,293 @@
+#include "column_log.hh"
+
+#include <cstring>
+
+using namespace std;
+using namespace column_log;
+
+namespace {
+
+constexpr string_view MAGIC = "R2T2COL1";
+
+void put_varint( string& out, uint64_t value )
+{
+  while ( value >= 0x80 ) {
+    out.push_back( static_cast<char>( ( value & 0x7f ) | 0x80 ) );
+    value >>= 7;
+  }
+
+  out.push_back( static_cast<char>( value ) );
+}
+
+uint64_t get_varint( const char*& in, const char* end )
+{
+  uint64_t value = 0;
+
+  for ( unsigned shift = 0; shift < 64; shift += 7 ) {
+    if ( in == end ) {
+      throw runtime_error( "column log: truncated varint" );
+    }
+
+    const auto byte = static_cast<uint8_t>( *in++ );
+    value |= static_cast<uint64_t>( byte & 0x7f ) << shift;
+
+    if ( not( byte & 0x80 ) ) {
+      return value;
+    }
+  }
+
+  throw runtime_error( "column log: varint is too long" );
+}
+
+/* reads a varint straight off the file; false at a clean end of file */
+bool read_varint( istream& in, uint64_t& value )
+{
+  value = 0;
+
+  for ( unsigned shift = 0; shift < 64; shift += 7 ) {
+    const int c = in.get();
+    if ( c == char_traits<char>::eof() ) {
+      if ( shift == 0 ) {
+        return false;
+      }
+
+      throw runtime_error( "column log: truncated varint" );
+    }
+
+    value |= static_cast<uint64_t>( c & 0x7f ) << shift;
+
+    if ( not( c & 0x80 ) ) {
+      return true;
+    }
+  }
+
+  throw runtime_error( "column log: varint is too long" );
+}
+
+uint64_t zigzag( const int64_t value )
+{
+  return ( static_cast<uint64_t>( value ) << 1 )
+         ^ static_cast<uint64_t>( value >> 63 );
+}
+
+int64_t unzigzag( const uint64_t value )
+{
+  return static_cast<int64_t>( value >> 1 )
+         ^ -static_cast<int64_t>( value & 1 );
+}
+
+}
+
+void Writer::open( const string& path, const vector<Column>& columns )
+{
+  close();
+
+  out_.open( path, ios::binary | ios::trunc );
+  if ( not out_ ) {
+    throw runtime_error( "column log: could not open " + path );
+  }
+
+  columns_ = columns;
+  data_.assign( columns_.size(), {} );
+  last_.assign( columns_.size(), 0 );
+  rows_ = 0;
+
+  string header { MAGIC };
+  put_varint( header, columns_.size() );
+
+  for ( const auto& column : columns_ ) {
+    header.push_back( static_cast<char>( column.type ) );
+    put_varint( header, column.name.length() );
+    header.append( column.name );
+  }
+
+  out_.write( header.data(), header.length() );
+}
+
+void Writer::check_type( const Type type )
+{
+  if ( cell_ >= columns_.size() or columns_[cell_].type != type ) {
+    throw runtime_error( "column log: wrong type for column "
+                         + to_string( cell_ ) );
+  }
+}
+
+void Writer::put( const int64_t value )
+{
+  check_type( Type::Int );
+
+  /* the rows of a stream tend to be alike, so deltas keep these short */
+  const uint64_t delta = static_cast<uint64_t>( value )
+                         - static_cast<uint64_t>( last_[cell_] );
+
+  put_varint( data_[cell_], zigzag( static_cast<int64_t>( delta ) ) );
+  last_[cell_] = value;
+  cell_++;
+}
+
+void Writer::put( const double value )
+{
+  check_type( Type::Double );
+
+  char bytes[sizeof( value )];
+  memcpy( bytes, &value, sizeof( value ) );
+  data_[cell_].append( bytes, sizeof( bytes ) );
+  cell_++;
+}
+
+void Writer::put( const string_view value )
+{
+  check_type( Type::String );
+
+  put_varint( data_[cell_], value.length() );
+  data_[cell_].append( value );
+  cell_++;
+}
+
+void Writer::flush()
+{
+  if ( rows_ == 0 or not out_.is_open() ) {
+    return;
+  }
+
+  size_t length = 0;
+  for ( const auto& column : data_ ) {
+    length += column.length();
+  }
+
+  string header;
+  put_varint( header, rows_ );
+  put_varint( header, length );
+  out_.write( header.data(), header.length() );
+
+  for ( auto& column : data_ ) {
+    out_.write( column.data(), column.length() );
+    column.clear();
+  }
+
+  out_.flush();
+
+  last_.assign( columns_.size(), 0 );
+  rows_ = 0;
+}
+
+void Writer::close()
+{
+  flush();
+
+  if ( out_.is_open() ) {
+    out_.close();
+  }
+}
+
+Reader::Reader( const string& path )
+  : in_( path, ios::binary )
+{
+  if ( not in_ ) {
+    throw runtime_error( "column log: could not open " + path );
+  }
+
+  string magic( MAGIC.length(), '\0' );
+  if ( not in_.read( magic.data(), magic.length() ) or magic != MAGIC ) {
+    throw runtime_error( "column log: " + path + " is not a column log" );
+  }
+
+  uint64_t count;
+  if ( not read_varint( in_, count ) ) {
+    throw runtime_error( "column log: truncated header" );
+  }
+
+  for ( uint64_t i = 0; i < count; i++ ) {
+    const int type = in_.get();
+    uint64_t length;
+
+    if ( type < 0 or type > static_cast<int>( Type::String )
+         or not read_varint( in_, length ) ) {
+      throw runtime_error( "column log: bad column in header" );
+    }
+
+    string name( length, '\0' );
+    if ( not in_.read( name.data(), length ) ) {
+      throw runtime_error( "column log: truncated header" );
+    }
+
+    columns_.push_back( { move( name ), static_cast<Type>( type ) } );
+  }
+
+  ints_.resize( columns_.size() );
+  doubles_.resize( columns_.size() );
+  strings_.resize( columns_.size() );
+}
+
+bool Reader::read_chunk()
+{
+  uint64_t rows;
+  uint64_t length;
+
+  if ( not read_varint( in_, rows ) ) {
+    rows_ = 0;
+    return false;
+  }
+
+  if ( not read_varint( in_, length ) ) {
+    throw runtime_error( "column log: truncated chunk" );
+  }
+
+  string data( length, '\0' );
+  if ( not in_.read( data.data(), length ) ) {
+    throw runtime_error( "column log: truncated chunk" );
+  }
+
+  const char* in = data.data();
+  const char* end = in + data.length();
+
+  for ( size_t i = 0; i < columns_.size(); i++ ) {
+    ints_[i].clear();
+    doubles_[i].clear();
+    strings_[i].clear();
+
+    switch ( columns_[i].type ) {
+      case Type::Int: {
+        uint64_t value = 0;
+        for ( uint64_t r = 0; r < rows; r++ ) {
+          value += static_cast<uint64_t>( unzigzag( get_varint( in, end ) ) );
+          ints_[i].push_back( static_cast<int64_t>( value ) );
+        }
+
+        break;
+      }
+
+      case Type::Double:
+        for ( uint64_t r = 0; r < rows; r++ ) {
+          double value;
+
+          if ( static_cast<size_t>( end - in ) < sizeof( value ) ) {
+            throw runtime_error( "column log: truncated chunk" );
+          }
+
+          memcpy( &value, in, sizeof( value ) );
+          doubles_[i].push_back( value );
+          in += sizeof( value );
+        }
+
+        break;
+
+      case Type::String:
+        for ( uint64_t r = 0; r < rows; r++ ) {
+          const uint64_t len = get_varint( in, end );
+
+          if ( static_cast<uint64_t>( end - in ) < len ) {
+            throw runtime_error( "column log: truncated chunk" );
+          }
+
+          strings_[i].emplace_back( in, len );
+          in += len;
+        }
+
+        break;
+    }
+  }
+
+  rows_ = rows;
+  return true;
+}
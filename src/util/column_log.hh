@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/* An append-only, columnar log of fixed-schema rows, for the stats that
+   are written often enough for CSV formatting to show up in a profile.
+
+     header := "R2T2COL1" count { type name-length name }*
+     chunk  := rows length { column }*
+
+   A chunk holds up to CHUNK_ROWS rows, column after column. Integers are
+   zigzag varints of the difference from the row above, doubles are raw
+   (little-endian) bytes, and strings are a varint length and the bytes.
+   A log cut short loses at most its last chunk. */
+namespace column_log {
+
+enum class Type : uint8_t
+{
+  Int = 0,
+  Double = 1,
+  String = 2,
+};
+
+struct Column
+{
+  std::string name;
+  Type type;
+};
+
+/* an integer cell with nothing in it; it's written out as an empty field */
+constexpr int64_t NONE = std::numeric_limits<int64_t>::min();
+
+class Writer
+{
+public:
+  static constexpr size_t CHUNK_ROWS = 4096;
+
+private:
+  std::ofstream out_ {};
+  std::vector<Column> columns_ {};
+  std::vector<std::string> data_ {};
+  std::vector<int64_t> last_ {};
+  size_t rows_ { 0 };
+  size_t cell_ { 0 };
+
+  void check_type( const Type type );
+
+  void put( const int64_t value );
+  void put( const double value );
+  void put( const std::string_view value );
+
+  template<class T>
+  void put_cell( const T& value );
+
+public:
+  Writer() = default;
+  ~Writer() { close(); }
+
+  Writer( const Writer& ) = delete;
+  Writer& operator=( const Writer& ) = delete;
+
+  void open( const std::string& path, const std::vector<Column>& columns );
+  bool is_open() const { return out_.is_open(); }
+
+  /* one argument per column, in order */
+  template<class... Args>
+  void append( const Args&... values );
+
+  void flush();
+  void close();
+};
+
+class Reader
+{
+private:
+  std::ifstream in_;
+  std::vector<Column> columns_ {};
+
+  std::vector<std::vector<int64_t>> ints_ {};
+  std::vector<std::vector<double>> doubles_ {};
+  std::vector<std::vector<std::string>> strings_ {};
+  size_t rows_ { 0 };
+
+public:
+  Reader( const std::string& path );
+
+  const std::vector<Column>& columns() const { return columns_; }
+
+  /* returns false at the end of the log */
+  bool read_chunk();
+
+  size_t rows() const { return rows_; }
+
+  /* the cells of column i in the current chunk, by its type */
+  const std::vector<int64_t>& ints( const size_t i ) const { return ints_[i]; }
+  const std::vector<double>& doubles( const size_t i ) const
+  {
+    return doubles_[i];
+  }
+
+  const std::vector<std::string>& strings( const size_t i ) const
+  {
+    return strings_[i];
+  }
+};
+
+template<class T>
+void Writer::put_cell( const T& value )
+{
+  if constexpr ( std::is_integral_v<T> ) {
+    put( static_cast<int64_t>( value ) );
+  } else if constexpr ( std::is_floating_point_v<T> ) {
+    put( static_cast<double>( value ) );
+  } else {
+    put( std::string_view { value } );
+  }
+}
+
+template<class... Args>
+void Writer::append( const Args&... values )
+{
+  /* a log that was never opened (e.g., stat logs are off) takes nothing */
+  if ( not is_open() ) {
+    return;
+  }
+
+  if ( sizeof...( Args ) != columns_.size() ) {
+    throw std::runtime_error( "column log: wrong number of cells" );
+  }
+
+  cell_ = 0;
+  ( put_cell( values ), ... );
+
+  if ( ++rows_ == CHUNK_ROWS ) {
+    flush();
+  }
+}
+
+} // namespace column_log
@@ -178,8 +178,9 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
           }
 
           rule_fired = true;
+          auto& category = _rule_categories.at( this_rule.category_id );
           RecordScopeTimer<Timer::Category::Nonblock> record_timer {
-            _rule_categories.at( this_rule.category_id ).timer
+            category.timer, &category.latency
           };
           this_rule.callback();
         }
@@ -299,8 +300,9 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
     }
 
     if ( this_rule.current_in_interested && ( this_events & EPOLLIN ) ) {
+      auto& category = _rule_categories.at( this_rule.category_id );
       RecordScopeTimer<Timer::Category::Nonblock> record_timer {
-        _rule_categories.at( this_rule.category_id ).timer
+        category.timer, &category.latency
       };
 
       const auto count_before = this_rule.fd.read_count();
@@ -315,8 +317,9 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
     }
 
     if ( this_rule.current_out_interested && ( this_events & EPOLLOUT ) ) {
+      auto& category = _rule_categories.at( this_rule.category_id );
       RecordScopeTimer<Timer::Category::Nonblock> record_timer {
-        _rule_categories.at( this_rule.category_id ).timer
+        category.timer, &category.latency
       };
 
       const auto count_before = this_rule.fd.write_count();
@@ -396,7 +399,8 @@ string EventLoop::summary() const
 
     accounted += timer.total_ns;
 
-    out << "\x1B[2m [max=" << Timer::pp_ns( timer.max_ns );
+    out << "\x1B[2m [p99=" << Timer::pp_ns( rule.latency.quantile( 0.99 ) );
+    out << ", max=" << Timer::pp_ns( timer.max_ns );
     out << ", count=" << timer.count << "]\x1B[0m";
     out << "\n";
   }
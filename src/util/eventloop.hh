@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <deque>
 #include <functional>
 #include <list>
 #include <memory>
@@ -43,6 +44,7 @@ private:
   {
     std::string name;
     Timer::Record timer;
+    Histogram latency {}; /* of the callbacks, in nanoseconds */
   };
 
   struct BasicRule
@@ -108,7 +110,8 @@ private:
                                          ::epoll_create1( 0 ) ) };
   std::array<epoll_event, 512> _epoll_events {};
 
-  std::vector<RuleCategory> _rule_categories {};
+  /* a deque, as callbacks add categories while their own is being timed */
+  std::deque<RuleCategory> _rule_categories {};
 
   std::list<std::shared_ptr<FDRule>> _fd_rules {};
   std::list<std::shared_ptr<Rule>> _non_fd_rules {};
@@ -32,7 +32,7 @@ void rename( const filesystem::path& oldpath, const filesystem::path& newpath )
   SystemCall( "rename", ::rename( oldpath.c_str(), newpath.c_str() ) );
 }
 
-void atomic_create( const string& contents,
+void atomic_create( const string_view contents,
                     const filesystem::path& dst,
                     const bool set_mode,
                     const mode_t target_mode )
@@ -43,7 +43,7 @@ void atomic_create( const string& contents,
     tmp_file_name = tmp_file.name();
 
     if ( contents.size() > 0 ) {
-      tmp_file.fd().write( contents );
+      tmp_file.fd().write_all( contents );
     }
 
     if ( set_mode ) {
@@ -4,6 +4,7 @@
 
 #include <filesystem>
 #include <string>
+#include <string_view>
 #include <sys/stat.h>
 #include <vector>
 
@@ -13,7 +14,7 @@ namespace roost {
 
 std::string read_file( const std::filesystem::path& pathn );
 
-void atomic_create( const std::string& contents,
+void atomic_create( const std::string_view contents,
                     const std::filesystem::path& dst,
                     const bool set_mode = false,
                     const mode_t target_mode = 0 );
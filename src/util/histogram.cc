@@ -1,94 +1,238 @@
 #include "util/histogram.hh"
 
+#include <algorithm>
+#include <cmath>
 #include <sstream>
 #include <stdexcept>
-
-#include "messages/utils.hh"
+#include <utility>
 
 using namespace std;
-using namespace r2t2;
-
-template<class T>
-Histogram<T>::Histogram( const T width,
-                         const T lower_bound,
-                         const T upper_bound )
-  : width_( width )
-  , lower_bound_( lower_bound )
-  , upper_bound_( upper_bound )
+
+size_t Histogram::bin( const uint64_t value )
+{
+  if ( value < 2 * SUB_BUCKETS ) {
+    return value;
+  }
+
+  /* the values with the same top SUB_BUCKET_BITS + 1 bits share a bin */
+  const unsigned top_bit = 63 - __builtin_clzll( value );
+  const unsigned shift = top_bit - SUB_BUCKET_BITS;
+
+  return ( shift + 1 ) * SUB_BUCKETS + ( value >> shift ) - SUB_BUCKETS;
+}
+
+uint64_t Histogram::bin_lower_bound( const size_t bin )
+{
+  if ( bin < 2 * SUB_BUCKETS ) {
+    return bin;
+  }
+
+  const size_t shift = bin / SUB_BUCKETS - 1;
+  return ( SUB_BUCKETS + bin % SUB_BUCKETS ) << shift;
+}
+
+uint64_t Histogram::bin_upper_bound( const size_t bin )
+{
+  if ( bin < 2 * SUB_BUCKETS ) {
+    return bin;
+  }
+
+  const size_t shift = bin / SUB_BUCKETS - 1;
+  return bin_lower_bound( bin ) + ( ( uint64_t { 1 } << shift ) - 1 );
+}
+
+Histogram::Histogram( const size_t first_bin,
+                      const vector<uint64_t>& bins,
+                      const uint64_t sum,
+                      const uint64_t min,
+                      const uint64_t max )
+  : sum_( sum )
+  , min_( min )
+  , max_( max )
 {
-  bins_.resize(
-    static_cast<size_t>( ( upper_bound_ - lower_bound_ + width_ ) / width_ ) );
+  if ( first_bin + bins.size() > BINS ) {
+    throw runtime_error( "histogram: too many bins" );
+  }
+
+  if ( bins.empty() ) {
+    return;
+  }
+
+  bins_.resize( first_bin + bins.size() );
+  copy( bins.begin(), bins.end(), bins_.begin() + first_bin );
+
+  for ( const auto c : bins ) {
+    count_ += c;
+  }
+}
+
+void Histogram::add( const uint64_t value, const uint64_t count )
+{
+  const size_t b = bin( value );
+
+  if ( b >= bins_.size() ) {
+    bins_.resize( b + 1 );
+  }
+
+  bins_[b] += count;
+  count_ += count;
+  sum_ += value * count;
+  min_ = std::min( min_, value );
+  max_ = std::max( max_, value );
+}
+
+void Histogram::merge( const Histogram& other )
+{
+  if ( other.bins_.size() > bins_.size() ) {
+    bins_.resize( other.bins_.size() );
+  }
+
+  for ( size_t i = 0; i < other.bins_.size(); i++ ) {
+    bins_[i] += other.bins_[i];
+  }
+
+  count_ += other.count_;
+  sum_ += other.sum_;
+  min_ = std::min( min_, other.min_ );
+  max_ = std::max( max_, other.max_ );
 }
 
-template<class T>
-void Histogram<T>::add( const T value )
+void Histogram::subtract( const Histogram& other )
 {
-  if ( value < lower_bound_ || value > upper_bound_ ) {
-    throw runtime_error( "value < lower_bound || value > upper_bound" );
+  if ( other.bins_.size() > bins_.size() or other.count_ > count_ ) {
+    throw runtime_error( "histogram: subtracting a larger histogram" );
   }
 
-  count_++;
-  min_value_ = min( value, min_value_ );
-  max_value_ = max( value, max_value_ );
-  sum_ += value;
-  squares_sum_ += value * value;
+  for ( size_t i = 0; i < other.bins_.size(); i++ ) {
+    if ( other.bins_[i] > bins_[i] ) {
+      throw runtime_error( "histogram: subtracting a larger histogram" );
+    }
+
+    bins_[i] -= other.bins_[i];
+  }
 
-  const size_t bin = static_cast<size_t>( ( value - lower_bound_ ) / width_ );
-  bins_[bin]++;
+  count_ -= other.count_;
+  sum_ -= other.sum_;
+  reset_extremes();
 }
 
-template<>
-Histogram<uint64_t>::Histogram( const protobuf::HistogramUInt64& proto )
-  : width_( proto.width() )
-  , lower_bound_( proto.lower_bound() )
-  , upper_bound_( proto.upper_bound() )
-  , count_( proto.count() )
-  , min_value_( proto.min() )
-  , max_value_( proto.max() )
-  , sum_( proto.sum() )
-  , squares_sum_( proto.squares_sum() )
+void Histogram::reset_extremes()
 {
-  bins_.resize(
-    static_cast<size_t>( ( upper_bound_ - lower_bound_ + width_ ) / width_ ) );
+  const auto first = find_if( bins_.begin(), bins_.end(), []( auto c ) {
+    return c > 0;
+  } );
+
+  if ( first == bins_.end() ) {
+    bins_.clear();
+    min_ = numeric_limits<uint64_t>::max();
+    max_ = 0;
+    return;
+  }
 
-  size_t i = 0;
-  for ( const auto bin : proto.bins() ) {
-    bins_[i++] = bin;
+  size_t last = bins_.size();
+  while ( bins_[last - 1] == 0 ) {
+    last--;
   }
+
+  bins_.resize( last );
+  min_ = std::max( min_, bin_lower_bound( first - bins_.begin() ) );
+  max_ = std::min( max_, bin_upper_bound( last - 1 ) );
 }
 
-template<>
-protobuf::HistogramUInt64 Histogram<uint64_t>::to_protobuf() const
+uint64_t Histogram::quantile( const double q ) const
 {
-  protobuf::HistogramUInt64 proto;
+  if ( count_ == 0 ) {
+    return 0;
+  }
+
+  const uint64_t rank
+    = std::max<uint64_t>( 1, static_cast<uint64_t>( ceil( q * count_ ) ) );
 
-  proto.set_width( width() );
-  proto.set_lower_bound( lower_bound() );
-  proto.set_upper_bound( upper_bound() );
-  proto.set_count( count() );
-  proto.set_min( min_value() );
-  proto.set_max( max_value() );
-  proto.set_sum( sum() );
-  proto.set_squares_sum( squares_sum() );
+  uint64_t seen = 0;
 
-  size_t lastPos;
-  for ( lastPos = bins_.size(); lastPos > 0; lastPos-- ) {
-    if ( bins_[lastPos - 1] != 0 )
-      break;
+  for ( size_t i = 0; i < bins_.size(); i++ ) {
+    seen += bins_[i];
+
+    if ( seen >= rank ) {
+      return std::min( bin_upper_bound( i ), max_ );
+    }
   }
 
-  *proto.mutable_bins() = { bins_.begin(), bins_.begin() + lastPos };
+  return max_;
+}
+
+string Histogram::str() const
+{
+  ostringstream oss;
+  oss << "count=" << count() << ", min=" << min() << ", p50=" << quantile( 0.5 )
+      << ", p99=" << quantile( 0.99 ) << ", max=" << max();
+
+  return oss.str();
+}
+
+atomic<uint64_t> HistogramRecorder::next_id_ { 0 };
+
+HistogramRecorder::Shard& HistogramRecorder::local_shard()
+{
+  /* the shards this thread has, by recorder; usually just one or two */
+  thread_local vector<pair<uint64_t, Shard*>> local;
+
+  for ( const auto& [id, shard] : local ) {
+    if ( id == id_ ) {
+      return *shard;
+    }
+  }
 
-  return proto;
+  lock_guard<mutex> lock { shards_mutex_ };
+  Shard* shard = shards_.emplace_back( make_unique<Shard>() ).get();
+  local.emplace_back( id_, shard );
+  return *shard;
 }
 
-template<>
-string Histogram<uint64_t>::str() const
+void HistogramRecorder::add( const uint64_t value )
 {
-  return protoutil::to_json( to_protobuf() );
+  Shard& shard = local_shard();
+
+  /* only this thread writes to its shard, so these needn't be atomic
+     read-modify-writes */
+  auto increase = []( atomic<uint64_t>& a, const uint64_t n ) {
+    a.store( a.load( memory_order_relaxed ) + n, memory_order_relaxed );
+  };
+
+  increase( shard.bins[Histogram::bin( value )], 1 );
+  increase( shard.sum, value );
+
+  if ( value < shard.min.load( memory_order_relaxed ) ) {
+    shard.min.store( value, memory_order_relaxed );
+  }
+
+  if ( value > shard.max.load( memory_order_relaxed ) ) {
+    shard.max.store( value, memory_order_relaxed );
+  }
 }
 
-template class Histogram<uint8_t>;
-template class Histogram<uint16_t>;
-template class Histogram<uint32_t>;
-template class Histogram<uint64_t>;
+Histogram HistogramRecorder::snapshot() const
+{
+  Histogram result;
+  lock_guard<mutex> lock { shards_mutex_ };
+
+  for ( const auto& shard : shards_ ) {
+    vector<uint64_t> bins( Histogram::BINS );
+
+    for ( size_t i = 0; i < Histogram::BINS; i++ ) {
+      bins[i] = shard->bins[i].load( memory_order_relaxed );
+    }
+
+    while ( not bins.empty() and bins.back() == 0 ) {
+      bins.pop_back();
+    }
+
+    result.merge( { 0,
+                    bins,
+                    shard->sum.load( memory_order_relaxed ),
+                    shard->min.load( memory_order_relaxed ),
+                    shard->max.load( memory_order_relaxed ) } );
+  }
+
+  return result;
+}
@@ -1,42 +1,110 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
-#include "r2t2.pb.h"
+/* A log-linear histogram of non-negative integers, along the lines of
+   HdrHistogram. Values below 2 * SUB_BUCKETS get a bin each; above that,
+   each power of two is cut into SUB_BUCKETS bins of equal width. A value
+   and the bin it lands in are never more than 1 / SUB_BUCKETS (about 3%)
+   apart, whether it's a few microseconds or a few hours.
 
-template<class T>
+   Histograms of the same quantity can be merged, e.g. across workers, and
+   an earlier snapshot can be subtracted to get what happened in between.
+   Bins are allocated up to the largest value seen. */
 class Histogram
 {
+public:
+  static constexpr unsigned SUB_BUCKET_BITS = 5;
+  static constexpr uint64_t SUB_BUCKETS = uint64_t { 1 } << SUB_BUCKET_BITS;
+  static constexpr size_t BINS = ( 65 - SUB_BUCKET_BITS ) * SUB_BUCKETS;
+
+  static size_t bin( const uint64_t value );
+
+  /* the smallest and the largest value that land in a bin */
+  static uint64_t bin_lower_bound( const size_t bin );
+  static uint64_t bin_upper_bound( const size_t bin );
+
 private:
-  T width_;
-  T lower_bound_;
-  T upper_bound_;
-  std::vector<size_t> bins_ {};
+  std::vector<uint64_t> bins_ {};
+  uint64_t count_ { 0 };
+  uint64_t sum_ { 0 };
+  uint64_t min_ { std::numeric_limits<uint64_t>::max() };
+  uint64_t max_ { 0 };
 
-  uint64_t count_ = 0;
-  T min_value_ = std::numeric_limits<T>::max();
-  T max_value_ = std::numeric_limits<T>::min();
-  T sum_ = 0;
-  T squares_sum_ = 0;
+  /* after a subtraction, min and max are narrowed down to the bins left */
+  void reset_extremes();
 
 public:
-  Histogram( const r2t2::protobuf::HistogramUInt64& proto );
-  Histogram( const T width, const T lower_bound, const T upper_bound );
+  Histogram() = default;
+
+  /* bins[i] is the count for bin first_bin + i */
+  Histogram( const size_t first_bin,
+             const std::vector<uint64_t>& bins,
+             const uint64_t sum,
+             const uint64_t min,
+             const uint64_t max );
+
+  void add( const uint64_t value, const uint64_t count = 1 );
 
-  void add( const T value );
+  void merge( const Histogram& other );
 
-  T width() const { return width_; }
-  T lower_bound() const { return lower_bound_; }
-  T upper_bound() const { return upper_bound_; }
-  const std::vector<size_t>& bins() const { return bins_; }
+  /* `other` has to be an earlier snapshot of the same histogram */
+  void subtract( const Histogram& other );
+
+  void clear() { *this = {}; }
+
+  const std::vector<uint64_t>& bins() const { return bins_; }
   uint64_t count() const { return count_; }
-  T min_value() const { return min_value_; }
-  T max_value() const { return max_value_; }
-  T sum() const { return sum_; }
-  T squares_sum() const { return squares_sum_; }
+  uint64_t sum() const { return sum_; }
+  uint64_t min() const { return count_ ? min_ : 0; }
+  uint64_t max() const { return max_; }
+  double mean() const { return count_ ? 1.0 * sum_ / count_ : 0.0; }
+
+  /* the largest value in the bin of the q-quantile, capped by max() */
+  uint64_t quantile( const double q ) const;
 
   std::string str() const;
-  r2t2::protobuf::HistogramUInt64 to_protobuf() const;
+};
+
+/* Takes values from any number of threads without locking. Each thread adds
+   to a shard of its own, and snapshot() sums the shards up; a snapshot
+   taken while threads are recording may miss their latest values. */
+class HistogramRecorder
+{
+private:
+  struct Shard
+  {
+    std::array<std::atomic<uint64_t>, Histogram::BINS> bins {};
+    std::atomic<uint64_t> sum { 0 };
+    std::atomic<uint64_t> min { std::numeric_limits<uint64_t>::max() };
+    std::atomic<uint64_t> max { 0 };
+  };
+
+  /* tells recorders apart in the threads' lists of shards, even when one
+     is created where another one used to be */
+  static std::atomic<uint64_t> next_id_;
+
+  const uint64_t id_ { next_id_++ };
+
+  mutable std::mutex shards_mutex_ {};
+  std::vector<std::unique_ptr<Shard>> shards_ {};
+
+  Shard& local_shard();
+
+public:
+  HistogramRecorder() = default;
+
+  HistogramRecorder( const HistogramRecorder& ) = delete;
+  HistogramRecorder& operator=( const HistogramRecorder& ) = delete;
+
+  void add( const uint64_t value );
+
+  Histogram snapshot() const;
 };
@@ -0,0 +1,109 @@
+#include "lz4_frame.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+namespace lz4_frame {
+
+/* the decoder never works with less free space than this */
+constexpr size_t MIN_OUTPUT_SPACE = 64 * 1024;
+
+void check( const size_t result )
+{
+  if ( LZ4F_isError( result ) ) {
+    throw runtime_error( "lz4: "s + LZ4F_getErrorName( result ) );
+  }
+}
+
+bool is_compressed( const string_view key )
+{
+  return key.length() > SUFFIX.length()
+         and key.substr( key.length() - SUFFIX.length() ) == SUFFIX;
+}
+
+string compress( const string_view input )
+{
+  LZ4F_preferences_t preferences {};
+  preferences.frameInfo.blockSizeID = LZ4F_max4MB;
+  preferences.frameInfo.contentSize = input.length();
+
+  /* objects are compressed once and decompressed by every worker */
+  preferences.compressionLevel = 9;
+
+  string output( LZ4F_compressFrameBound( input.length(), &preferences ),
+                 '\0' );
+
+  const size_t length = LZ4F_compressFrame( output.data(),
+                                            output.length(),
+                                            input.data(),
+                                            input.length(),
+                                            &preferences );
+  check( length );
+
+  output.resize( length );
+  return output;
+}
+
+string decompress( const string_view input )
+{
+  Decoder decoder;
+  decoder.decompress( input );
+  return decoder.finish();
+}
+
+Decoder::Decoder()
+{
+  LZ4F_dctx* context;
+  check( LZ4F_createDecompressionContext( &context, LZ4F_VERSION ) );
+  context_.reset( context );
+}
+
+void Decoder::decompress( string_view input )
+{
+  while ( not done_ ) {
+    if ( output_.length() - output_length_ < MIN_OUTPUT_SPACE ) {
+      output_.resize(
+        max( 2 * output_.length(), output_length_ + MIN_OUTPUT_SPACE ) );
+    }
+
+    const size_t available = output_.length() - output_length_;
+    size_t written = available;
+    size_t consumed = input.length();
+
+    const size_t hint = LZ4F_decompress( context_.get(),
+                                         output_.data() + output_length_,
+                                         &written,
+                                         input.data(),
+                                         &consumed,
+                                         nullptr );
+    check( hint );
+
+    output_length_ += written;
+    input.remove_prefix( consumed );
+    done_ = ( hint == 0 );
+
+    /* a full output buffer means the decoder may be holding on to more */
+    if ( input.empty() and written < available ) {
+      break;
+    }
+  }
+
+  if ( not input.empty() ) {
+    throw runtime_error( "lz4: data after the end of the frame" );
+  }
+}
+
+string Decoder::finish()
+{
+  if ( not done_ ) {
+    throw runtime_error( "lz4: truncated frame" );
+  }
+
+  output_.resize( output_length_ );
+  output_length_ = 0;
+  return move( output_ );
+}
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <lz4frame.h>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace lz4_frame {
+
+/* objects stored in the LZ4 frame format have this suffix */
+constexpr std::string_view SUFFIX { ".lz4" };
+
+bool is_compressed( std::string_view key );
+
+std::string compress( std::string_view input );
+std::string decompress( std::string_view input );
+
+/* expands a frame piece by piece, as it arrives */
+class Decoder
+{
+private:
+  std::unique_ptr<LZ4F_dctx, decltype( &LZ4F_freeDecompressionContext )>
+    context_ { nullptr, LZ4F_freeDecompressionContext };
+
+  std::string output_ {};
+  size_t output_length_ { 0 };
+  bool done_ { false };
+
+public:
+  Decoder();
+
+  void decompress( std::string_view input );
+
+  /* returns everything decoded so far; throws if the frame is incomplete */
+  std::string finish();
+};
+
+}
@@ -0,0 +1,28 @@
+#include "memory.hh"
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+MemoryStats::MemoryStats()
+{
+  ifstream fin { "/proc/self/statm" };
+  uint64_t size, pages;
+
+  if ( not( fin >> size >> pages ) ) {
+    throw runtime_error( "unsupported format for /proc/self/statm" );
+  }
+
+  resident = pages * sysconf( _SC_PAGESIZE );
+}
+
+uint64_t MemoryStats::limit()
+{
+  const char* memory_size = getenv( "AWS_LAMBDA_FUNCTION_MEMORY_SIZE" );
+  return memory_size ? stoull( memory_size ) * 1024 * 1024 : 0;
+}
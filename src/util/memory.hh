@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+class MemoryStats
+{
+public:
+  MemoryStats();
+
+  /* the memory this process is allowed, from AWS_LAMBDA_FUNCTION_MEMORY_SIZE
+     when running on Lambda; zero if it isn't known */
+  static uint64_t limit();
+
+  uint64_t resident { 0 }; /* bytes */
+};
@@ -7,6 +7,8 @@
 #include <stdexcept>
 #include <type_traits>
 
+#include "histogram.hh"
+
 class Timer
 {
 public:
@@ -39,7 +41,9 @@ public:
     DNS,
     Nonblock,
     WaitingForEvent,
+    ReadingTreelet,
     LoadingTreelet,
+    MappingTreelet,
     count
   };
 
@@ -47,7 +51,12 @@ public:
     = static_cast<size_t>( Category::count );
 
   constexpr static std::array<const char*, num_categories> _category_names {
-    { "DNS", "Nonblocking operations", "Waiting for event", "Loading treelet" }
+    { "DNS",
+      "Nonblocking operations",
+      "Waiting for event",
+      "Reading treelet",
+      "Loading treelet",
+      "Loading treelet (mmap + parse)" }
   };
 
 private:
@@ -102,11 +111,13 @@ template<Timer::Category category>
 class RecordScopeTimer
 {
   Timer::Record* _timer;
+  Histogram* _histogram;
   uint64_t _start_time;
 
 public:
-  RecordScopeTimer( Timer::Record& timer )
+  RecordScopeTimer( Timer::Record& timer, Histogram* histogram = nullptr )
     : _timer( &timer )
+    , _histogram( histogram )
     , _start_time( Timer::timestamp_ns() )
   {
     global_timer().start<category>( _start_time );
@@ -116,6 +127,11 @@ public:
   {
     const uint64_t now = Timer::timestamp_ns();
     _timer->log( now - _start_time );
+
+    if ( _histogram ) {
+      _histogram->add( now - _start_time );
+    }
+
     global_timer().stop<category>( now );
   }
 
@@ -12,7 +12,7 @@ using namespace std;
 ParsedURI::ParsedURI( const std::string& uri )
 {
   const static regex uri_regex {
-    R"RAWSTR((([A-Za-z0-9]+)://)?(([^:\n\r]+):([^@\n\r]+)@)?(([^?:/\n\r]+):?(\d*))/?([^?\n\r]+)?\??([^#\n\r]*)?#?([^\n\r]*))RAWSTR"
+    R"RAWSTR((([A-Za-z0-9]+)://)?(([^:\n\r]+):([^@\n\r]+)@)?(([^?:/\n\r]+):?(\d*))?/?([^?\n\r]+)?\??([^#\n\r]*)?#?([^\n\r]*))RAWSTR"
   };
 
   smatch uri_match_result;
@@ -62,3 +62,21 @@ string format_num( size_t num )
   oss << fixed << setprecision( 1 ) << val << sizes[i];
   return oss.str();
 }
+
+string format_duration( const chrono::microseconds duration )
+{
+  const auto us = duration.count();
+
+  ostringstream oss;
+  oss << fixed << setprecision( 1 );
+
+  if ( us < 1000 ) {
+    oss << us << "us";
+  } else if ( us < 1'000'000 ) {
+    oss << us / 1e3 << "ms";
+  } else {
+    oss << us / 1e6 << "s";
+  }
+
+  return oss.str();
+}
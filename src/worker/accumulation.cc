@@ -13,6 +13,7 @@ void LambdaWorker::handle_accumulation_queue()
 
     do {
       sample_queue_size--;
+      sample_queue_bytes -= sample_bag.length();
 
       if ( sample_bag.empty() ) {
         return;
@@ -28,30 +28,34 @@ void LambdaWorker::handle_out_queue()
 {
   bernoulli_distribution bd { config.bag_log_rate };
 
-  auto create_new_bag = [&]( const TreeletId treelet_id ) {
+  auto create_new_bag = [&]( const OutKey& key ) {
+    const auto& [treelet_id, source_treelet_id] = key;
+
     RayBag bag {
       *worker_id, treelet_id, current_bag_id[treelet_id]++, false, MAX_BAG_SIZE
     };
 
     bag.info.tracked = bd( rand_engine );
+    bag.info.source_treelet_id = source_treelet_id;
+
     log_bag( BagAction::Created, bag.info );
 
     if ( !seal_bags_timer.armed() ) {
       seal_bags_timer.set( 0s, current_bagging_delay() );
     }
 
-    return open_bags.insert_or_assign( treelet_id, move( bag ) ).first;
+    return open_bags.insert_or_assign( key, move( bag ) ).first;
   };
 
   for ( auto it = out_queue.begin(); it != out_queue.end();
         it = out_queue.erase( it ) ) {
-    const TreeletId treelet_id = it->first;
+    const OutKey& key = it->first;
     auto& ray_list = it->second;
 
-    auto bag_it = open_bags.find( treelet_id );
+    auto bag_it = open_bags.find( key );
 
     if ( bag_it == open_bags.end() ) {
-      bag_it = create_new_bag( treelet_id );
+      bag_it = create_new_bag( key );
     }
 
     auto& bag = bag_it->second;
@@ -60,11 +64,10 @@ void LambdaWorker::handle_out_queue()
       auto& ray = ray_list.front();
 
       if ( bag.info.bag_size + ray->MaxCompressedSize() > MAX_BAG_SIZE ) {
-        log_bag( BagAction::Sealed, bag.info );
-        sealed_bags.push( move( bag ) );
+        seal_bag( move( bag ) );
 
         /* let's create an empty bag */
-        bag = create_new_bag( treelet_id )->second;
+        bag = create_new_bag( key )->second;
       }
 
       const auto len = ray->Serialize( &bag.data[0] + bag.info.bag_size );
@@ -100,11 +103,10 @@ void LambdaWorker::handle_open_bags()
       continue;
     }
 
-    log_bag( BagAction::Sealed, it->second.info );
     it->second.data.erase( it->second.info.bag_size );
     it->second.data.shrink_to_fit();
 
-    sealed_bags.push( move( it->second ) );
+    seal_bag( move( it->second ) );
     it = open_bags.erase( it );
   }
 
@@ -113,6 +115,16 @@ void LambdaWorker::handle_open_bags()
   }
 }
 
+void LambdaWorker::seal_bag( RayBag&& bag )
+{
+  log_bag( BagAction::Sealed, bag.info );
+
+  bag.sealed_at = steady_clock::now();
+  record_bag_latency( BagStage::Open, bag.created_at );
+
+  sealed_bags.push( move( bag ) );
+}
+
 void LambdaWorker::handle_sealed_bags()
 {
   while ( !sealed_bags.empty() ) {
@@ -139,11 +151,12 @@ void LambdaWorker::handle_sealed_bags()
     bag.data.shrink_to_fit();
 
     log_bag( BagAction::Submitted, bag.info );
+    record_bag_latency( BagStage::Submit, bag.sealed_at );
 
     const auto id = transfer_agent->request_upload(
       bag.info.str( ray_bags_key_prefix ), move( bag.data ) );
 
-    pending_ray_bags[id] = make_pair( Task::Upload, bag.info );
+    pending_ray_bags[id] = { Task::Upload, bag.info };
     sealed_bags.pop();
   }
 }
@@ -214,7 +227,7 @@ void LambdaWorker::handle_sample_bags()
                             bag.info.tile_id );
 
     ( config.accumulators ? pending_ray_bags : pending_sample_bags )[id]
-      = make_pair( Task::Upload, bag.info );
+      = { Task::Upload, bag.info };
   };
 
   for ( auto& [_, bag] : open_sample_bags ) {
@@ -267,6 +280,7 @@ void LambdaWorker::handle_receive_queue()
       }
 
       sample_queue_size++;
+      sample_queue_bytes += bag.data.length();
       sample_queue.enqueue( move( bag.data ) );
     } else {
       const char* data = bag.data.data();
@@ -290,13 +304,17 @@ void LambdaWorker::handle_receive_queue()
     }
 
     log_bag( BagAction::Opened, bag.info );
+
+    if ( not bag.info.sample_bag ) {
+      record_bag_latency( BagStage::Unpack, bag.created_at );
+    }
   }
 }
 
 void LambdaWorker::handle_transfer_results( const bool for_sample_bags )
 {
-  protobuf::RayBags enqueued_proto;
-  protobuf::RayBags dequeued_proto;
+  enqueued_bags.clear();
+  dequeued_bags.clear();
 
   auto& agent = for_sample_bags ? samples_transfer_agent : transfer_agent;
   auto& pending = for_sample_bags ? pending_sample_bags : pending_ray_bags;
@@ -312,18 +330,23 @@ void LambdaWorker::handle_transfer_results( const bool for_sample_bags )
     auto info_it = pending.find( action.first );
 
     if ( info_it != pending.end() ) {
-      const auto& info = info_it->second.second;
+      const auto& info = info_it->second.info;
 
-      switch ( info_it->second.first ) {
+      switch ( info_it->second.task ) {
         case Task::Upload: {
           /* we have to tell the master that we uploaded this */
-          *enqueued_proto.add_items() = to_protobuf( info );
+          enqueued_bags.items.push_back( info );
 
           if ( not for_sample_bags ) {
             bytes_out_since_last_tick += info.bag_size;
           }
 
           log_bag( BagAction::Enqueued, info );
+
+          if ( not info.sample_bag ) {
+            record_bag_latency( BagStage::Upload, info_it->second.since );
+          }
+
           break;
         }
 
@@ -331,9 +354,14 @@ void LambdaWorker::handle_transfer_results( const bool for_sample_bags )
           /* we have to put the received bag on the receive queue,
              and tell the master */
           receive_queue.emplace( info, move( action.second ) );
-          *dequeued_proto.add_items() = to_protobuf( info );
+          dequeued_bags.items.push_back( info );
 
           log_bag( BagAction::Dequeued, info );
+
+          if ( not info.sample_bag ) {
+            record_bag_latency( BagStage::Download, info_it->second.since );
+          }
+
           break;
       }
 
@@ -341,23 +369,19 @@ void LambdaWorker::handle_transfer_results( const bool for_sample_bags )
     }
   }
 
-  if ( enqueued_proto.items_size() > 0 ) {
-    enqueued_proto.set_rays_generated( rays.generated );
-    enqueued_proto.set_rays_terminated( rays.terminated );
+  if ( not enqueued_bags.empty() ) {
+    enqueued_bags.rays_generated = rays.generated;
+    enqueued_bags.rays_terminated = rays.terminated;
 
     master_connection.push_request(
-      { *worker_id,
-        OpCode::RayBagEnqueued,
-        protoutil::to_string( enqueued_proto ) } );
+      { *worker_id, OpCode::RayBagEnqueued, enqueued_bags.encode() } );
   }
 
-  if ( dequeued_proto.items_size() > 0 ) {
-    dequeued_proto.set_rays_generated( rays.generated );
-    dequeued_proto.set_rays_terminated( rays.terminated );
+  if ( not dequeued_bags.empty() ) {
+    dequeued_bags.rays_generated = rays.generated;
+    dequeued_bags.rays_terminated = rays.terminated;
 
     master_connection.push_request(
-      { *worker_id,
-        OpCode::RayBagDequeued,
-        protoutil::to_string( dequeued_proto ) } );
+      { *worker_id, OpCode::RayBagDequeued, dequeued_bags.encode() } );
   }
 }
@@ -7,29 +7,36 @@
 
 #include <atomic>
 #include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <future>
 #include <iostream>
+#include <map>
 #include <optional>
 #include <queue>
 #include <random>
 #include <string>
 #include <thread>
 #include <tuple>
+#include <variant>
 
 #include "common/lambda.hh"
 #include "common/stats.hh"
 #include "common/tile_helper.hh"
+#include "common/trace.hh"
 #include "master/lambda-master.hh"
+#include "messages/bags.hh"
 #include "messages/message.hh"
 #include "net/address.hh"
 #include "net/s3.hh"
 #include "net/transfer.hh"
-#include "storage/backend_s3.hh"
+#include "storage/backend.hh"
+#include "storage/object_cache.hh"
 #include "util/cpu.hh"
 #include "util/eventfd.hh"
 #include "util/eventloop.hh"
 #include "util/histogram.hh"
+#include "util/ring_buffer.hh"
 #include "util/temp_dir.hh"
 #include "util/timerfd.hh"
 #include "util/units.hh"
@@ -37,14 +44,18 @@
 #include "concurrentqueue/blockingconcurrentqueue.h"
 #include "concurrentqueue/concurrentqueue.h"
 
-#define TLOG( tag ) LOG( INFO ) << "[" #tag "] "
-
 namespace r2t2 {
 
 constexpr std::chrono::milliseconds SAMPLE_BAGS_INTERVAL { 1'000 };
 constexpr std::chrono::milliseconds WORKER_STATS_INTERVAL { 1'000 };
 constexpr std::chrono::milliseconds UPLOAD_OUTPUT_INTERVAL { 2'000 };
 
+/* trace records are drained this often, and go out as a chunk once there
+   are enough of them or enough time has passed */
+constexpr std::chrono::milliseconds TRACE_DRAIN_INTERVAL { 100 };
+constexpr std::chrono::seconds TRACE_UPLOAD_INTERVAL { 10 };
+constexpr size_t TRACE_CHUNK_SIZE { 4 * 1024 * 1024 }; // 4 MiB
+
 constexpr size_t MAX_BAG_SIZE { 4 * 1024 * 1024 };        // 4 MiB
 constexpr size_t MAX_SAMPLE_BAG_SIZE { 4 * 1024 * 1024 }; // 4 MiB
 
@@ -59,6 +70,19 @@ struct WorkerConfiguration
 
   std::vector<Address> memcached_servers;
   int accumulators;
+
+  /* when the worker was invoked; a cold worker counts from its start */
+  std::chrono::system_clock::time_point invoked_at {
+    std::chrono::system_clock::now()
+  };
+
+  /* base scene objects a warm worker loaded ahead of the invocation */
+  std::map<std::string, std::string> preloaded_objects {};
+
+  /* scene objects are cached on disk across jobs, if the scene is known */
+  std::string scene_hash {};
+  std::filesystem::path cache_directory { "/tmp/r2t2-cache" };
+  uint64_t cache_size { 256 * 1024 * 1024 };
 };
 
 /* Relationship between different queues in LambdaWorker:
@@ -114,9 +138,43 @@ private:
   /*** Scene Information ****************************************************/
 
   bool scene_loaded { false };
-  std::vector<std::pair<TreeletId, std::string>> downloaded_treelets {};
+  bool base_scene_loaded { false };
+
+  /* treelets are loaded once the other objects they refer to are on disk */
+  bool dependencies_on_disk { false };
+  size_t pending_dependencies { 0 };
+
+  /* a treelet's bytes, either downloaded or mapped from a local file; the
+     loader parses either one into its own structures */
+  using TreeletBuffer = std::variant<std::string, MMap_Region>;
+
+  std::vector<std::pair<TreeletId, TreeletBuffer>> downloaded_treelets {};
   std::map<uint64_t, SceneObject> pending_scene_objects {};
 
+  /* treelets are loaded by a pool of threads, one per core, as soon as
+     they're in and the base scene is set up; the loads that aren't done
+     yet are in treelet_loads */
+  struct TreeletLoad
+  {
+    TreeletId id {};
+    TreeletBuffer data {};
+    std::promise<std::shared_ptr<pbrt::CloudBVH>> result {};
+  };
+
+  void handle_treelet_load_queue();
+  void shutdown_treelet_loaders();
+
+  EventFD treelet_loaded_fd {};
+  std::vector<std::thread> treelet_loaders {};
+  moodycamel::BlockingConcurrentQueue<std::unique_ptr<TreeletLoad>>
+    treelet_load_queue {};
+  std::vector<
+    std::pair<TreeletId, std::future<std::shared_ptr<pbrt::CloudBVH>>>>
+    treelet_loads {};
+  std::optional<ObjectCache> object_cache {};
+
+  static std::string object_name( const SceneObject& obj );
+
   struct SceneData
   {
   public:
@@ -140,6 +198,7 @@ private:
 
   void generate_rays( const pbrt::Bounds2i& crop_window );
 
+  void start_raytracing_threads();
   void shutdown_raytracing_threads();
 
   std::vector<std::thread> raytracing_threads {};
@@ -147,14 +206,25 @@ private:
 
   std::vector<pbrt::AccumulatedStats> raytracing_thread_stats {};
 
+  /* a ray that came out of a tracing thread, and the treelet it was in */
+  struct TracedRay
+  {
+    TreeletId source {};
+    pbrt::RayStatePtr ray {};
+  };
+
   moodycamel::BlockingConcurrentQueue<pbrt::RayStatePtr> trace_queue { 8192 };
-  moodycamel::ConcurrentQueue<pbrt::RayStatePtr> processed_queue { 8192 };
+  moodycamel::ConcurrentQueue<TracedRay> processed_queue { 8192 };
 
   std::atomic<size_t> trace_queue_size { 0 };
   std::atomic<size_t> processed_queue_size { 0 };
 
   std::map<TreeletId, std::shared_ptr<pbrt::CloudBVH>> treelets {};
-  std::map<TreeletId, std::queue<pbrt::RayStatePtr>> out_queue {};
+  /* rays that leave go out in bags per (treelet they go to, treelet they
+     were traced in); camera rays weren't traced in any yet */
+  using OutKey = std::pair<TreeletId, std::optional<TreeletId>>;
+
+  std::map<OutKey, std::queue<pbrt::RayStatePtr>> out_queue {};
   std::queue<pbrt::Sample> samples {};
   size_t out_queue_size { 0 };
 
@@ -169,6 +239,7 @@ private:
   std::vector<std::thread> accumulation_threads {};
   moodycamel::BlockingConcurrentQueue<std::string> sample_queue { 1024 };
   std::atomic<size_t> sample_queue_size { 0 };
+  std::atomic<size_t> sample_queue_bytes { 0 };
 
   std::string render_output_filename {};
   size_t render_output_id {0};
@@ -183,9 +254,8 @@ private:
 
   const Address coordinator_addr;
   meow::Client<TCPSession> master_connection;
-  Storage storage_backend_info;
-  S3StorageBackend scene_storage_backend;
-  S3StorageBackend job_storage_backend;
+  std::unique_ptr<StorageBackend> scene_storage_backend;
+  std::unique_ptr<StorageBackend> job_storage_backend;
 
   /* messages that can be processed only when the scene is fully loaded */
   std::queue<meow::Message> pending_messages {};
@@ -196,6 +266,13 @@ private:
   /* downloads the necessary scene objects */
   void get_and_setup_scene( const protobuf::GetObjects& objects );
 
+  /* drops the old treelet once its rays are traced, and loads the new one;
+     SwapTreelet is acknowledged the same way as GetObjects */
+  void swap_treelet();
+
+  std::optional<protobuf::SwapTreelet> pending_swap {};
+  std::optional<EventLoop::RuleHandle> swap_treelet_rule {};
+
   /* handle messages that are queued for when the scene is loaded */
   void handle_pending_messages();
 
@@ -208,6 +285,9 @@ private:
   /* sending the rays out */
   void handle_sealed_bags();
 
+  /* moves a bag that's done filling up to sealed_bags */
+  void seal_bag( RayBag&& bag );
+
   /* opening up received ray bags */
   void handle_receive_queue();
 
@@ -220,11 +300,24 @@ private:
   void handle_transfer_results( const bool sample_bags );
 
   void handle_scene_object_results();
+  void handle_treelet_loads();
+
+  /* keeps a scene object that was downloaded or preloaded */
+  void store_scene_object( const SceneObject& obj, std::string&& data );
+  void store_treelet( const TreeletId id, TreeletBuffer&& data );
+  void start_treelet_load( const TreeletId id, TreeletBuffer&& data );
+
+  /* once all the non-treelet objects are on disk, sets up the base scene
+     (the first time around) and then starts loading the treelets */
+  void start_treelet_loads();
+
+  /* acknowledges GetObjects once the treelets are loaded, too */
+  void finish_scene_setup();
 
   /* queues */
 
-  /* current bag for each treelet */
-  std::map<TreeletId, RayBag> open_bags {};
+  /* current bag for each destination and source treelet */
+  std::map<OutKey, RayBag> open_bags {};
 
   /* bags that are sealed and ready to be sent out */
   std::queue<RayBag> sealed_bags {};
@@ -259,8 +352,22 @@ private:
   std::string ray_bags_key_prefix {};
   std::map<TreeletId, BagId> current_bag_id {};
   std::map<TileId, BagId> current_sample_bag_id {};
-  std::map<uint64_t, std::pair<Task, RayBagInfo>> pending_ray_bags {};
-  std::map<uint64_t, std::pair<Task, RayBagInfo>> pending_sample_bags {};
+
+  /* a bag that's being uploaded or downloaded, and since when */
+  struct PendingBag
+  {
+    Task task {};
+    RayBagInfo info {};
+    steady_clock::time_point since { steady_clock::now() };
+  };
+
+  std::map<uint64_t, PendingBag> pending_ray_bags {};
+  std::map<uint64_t, PendingBag> pending_sample_bags {};
+
+  /* reused for every batch we send or get */
+  RayBagBatch enqueued_bags {};
+  RayBagBatch dequeued_bags {};
+  RayBagBatch assigned_bags {};
 
   /*** Transfer Agent *******************************************************/
 
@@ -268,6 +375,7 @@ private:
   std::unique_ptr<TransferAgent> samples_transfer_agent;
   std::unique_ptr<TransferAgent> output_transfer_agent;
   std::unique_ptr<TransferAgent> scene_transfer_agent;
+  std::unique_ptr<TransferAgent> trace_transfer_agent;
 
   ////////////////////////////////////////////////////////////////////////////
   // Stats                                                                  //
@@ -282,31 +390,17 @@ private:
     std::atomic<uint64_t> terminated { 0 };
   } rays {};
 
+  /* time from the invocation to the first ray this worker handled */
+  void mark_first_ray();
+
+  std::optional<std::chrono::microseconds> first_ray_latency {};
+  bool first_ray_reported { false };
+  bool cache_stats_reported { false };
+
   ////////////////////////////////////////////////////////////////////////////
   // Logging                                                                //
   ////////////////////////////////////////////////////////////////////////////
 
-  enum class RayAction
-  {
-    Generated,
-    Traced,
-    Queued,
-    Bagged,
-    Unbagged,
-    Finished
-  };
-
-  enum class BagAction
-  {
-    Created,
-    Sealed,
-    Submitted,
-    Enqueued,
-    Requested,
-    Dequeued,
-    Opened
-  };
-
   void log_ray( const RayAction action,
                 const pbrt::RayState& state,
                 const RayBagInfo& info = RayBagInfo::EmptyBag() );
@@ -319,6 +413,16 @@ private:
   const bool track_rays { config.ray_log_rate > 0 };
   const bool track_bags { config.bag_log_rate > 0 };
 
+  /* sampled ray and bag events; the event loop drains them into chunks,
+     which are uploaded as the job goes */
+  TraceRecorder trace_recorder {};
+  std::string trace_chunk {};
+  size_t trace_chunk_id { 0 };
+  steady_clock::time_point last_trace_upload { steady_clock::now() };
+
+  void handle_trace_records();
+  void upload_trace_chunk( const bool last = false );
+
   std::bernoulli_distribution coin { 0.5 };
   std::mt19937 rand_engine { std::random_device {}() };
 
@@ -344,11 +448,22 @@ private:
   TimerFD upload_output_timer { UPLOAD_OUTPUT_INTERVAL,
                                 random_initial( UPLOAD_OUTPUT_INTERVAL ) };
 
+  TimerFD trace_drain_timer { TRACE_DRAIN_INTERVAL };
+
   ////////////////////////////////////////////////////////////////////////////
   // Local Stats                                                            //
   ////////////////////////////////////////////////////////////////////////////
 
   CPUStats cpu_stats {};
+
+  /* how long ray bags spend in each stage here, since the last report */
+  BagLatencies bag_latencies {};
+
+  /* what transfer_agent->latency() was at the last report */
+  Histogram last_transfer_latency {};
+
+  void record_bag_latency( const BagStage stage,
+                           const steady_clock::time_point since );
 };
 
 } // namespace r2t2
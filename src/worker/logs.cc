@@ -5,6 +5,8 @@
 #include "lambda-worker.hh"
 #include "messages/utils.hh"
 #include "util/exception.hh"
+#include "util/memory.hh"
+#include "util/util.hh"
 
 using namespace std;
 using namespace chrono;
@@ -30,6 +32,40 @@ void LambdaWorker::send_worker_stats()
   stats.cpu_usage = 1.0 * work_jiffies / total_jiffies;
 
   protobuf::WorkerStats proto = to_protobuf( stats );
+
+  /* what the master weighs against this worker's share of memory */
+  proto.set_memory_usage( MemoryStats {}.resident );
+  proto.set_memory_limit( MemoryStats::limit() );
+  proto.set_queued_bytes(
+    ( trace_queue_size + processed_queue_size + out_queue_size )
+      * RayState::MaxPackedSize
+    + sample_queue_bytes );
+
+  if ( first_ray_latency and not first_ray_reported ) {
+    proto.set_first_ray_us( first_ray_latency->count() );
+    first_ray_reported = true;
+  }
+
+  for ( auto& histogram : bag_latencies ) {
+    *proto.add_bag_latencies() = to_protobuf( histogram );
+    histogram.clear();
+  }
+
+  /* the agent's histogram keeps growing; the master gets what's new */
+  Histogram transfer_latency = transfer_agent->latency();
+  Histogram new_transfers = transfer_latency;
+  new_transfers.subtract( last_transfer_latency );
+  *proto.mutable_transfer_latency() = to_protobuf( new_transfers );
+  last_transfer_latency = move( transfer_latency );
+
+  if ( object_cache and scene_loaded and not cache_stats_reported ) {
+    const auto& cache_stats = object_cache->stats();
+    proto.set_cache_hits( cache_stats.hits );
+    proto.set_cache_misses( cache_stats.misses );
+    proto.set_cache_bytes_saved( cache_stats.bytes_saved );
+    cache_stats_reported = true;
+  }
+
   master_connection.push_request(
     { *worker_id, OpCode::WorkerStats, protoutil::to_string( proto ) } );
 
@@ -49,6 +85,13 @@ void LambdaWorker::send_worker_stats()
   }
 }
 
+void LambdaWorker::record_bag_latency( const BagStage stage,
+                                       const steady_clock::time_point since )
+{
+  bag_latencies[to_underlying( stage )].add(
+    duration_cast<microseconds>( steady_clock::now() - since ).count() );
+}
+
 void LambdaWorker::handle_worker_stats()
 {
   worker_stats_timer.read_event();
@@ -70,8 +113,65 @@ void LambdaWorker::upload_logs()
     vector<storage::PutRequest> put_logs_request
       = { { info_log_name, log_prefix + to_string( *worker_id ) + ".INFO" } };
 
-    job_storage_backend.put( put_logs_request );
+    job_storage_backend->put( put_logs_request );
+  }
+
+  /* the agent finishes its uploads before it goes away; the last chunk is
+     uploaded even if it's empty, so the master knows where to look */
+  if ( trace_chunk.empty() ) {
+    trace_chunk.resize( sizeof( TraceHeader ) );
+  }
+
+  trace_recorder.drain( trace_chunk );
+  upload_trace_chunk( true );
+}
+
+void LambdaWorker::handle_trace_records()
+{
+  trace_drain_timer.read_event();
+
+  if ( trace_chunk.empty() ) {
+    trace_chunk.resize( sizeof( TraceHeader ) );
   }
+
+  trace_recorder.drain( trace_chunk );
+
+  /* nothing to do with the results of earlier uploads */
+  if ( trace_transfer_agent->eventfd().read_event() ) {
+    vector<pair<uint64_t, string>> results;
+    trace_transfer_agent->try_pop_bulk( back_inserter( results ) );
+  }
+
+  if ( trace_chunk.length() >= TRACE_CHUNK_SIZE
+       or steady_clock::now() - last_trace_upload >= TRACE_UPLOAD_INTERVAL ) {
+    upload_trace_chunk();
+  }
+}
+
+void LambdaWorker::upload_trace_chunk( const bool last )
+{
+  last_trace_upload = steady_clock::now();
+
+  if ( !worker_id
+       or ( not last and trace_chunk.length() <= sizeof( TraceHeader ) ) ) {
+    return;
+  }
+
+  TraceHeader header;
+  memcpy( header.magic, TraceHeader::MAGIC.data(), sizeof( header.magic ) );
+  header.worker_id = *worker_id;
+  header.dropped_records = trace_recorder.dropped();
+  header.earlier_chunks = trace_chunk_id;
+  memcpy( trace_chunk.data(), &header, sizeof( header ) );
+
+  const string name
+    = last ? to_string( *worker_id )
+           : to_string( *worker_id ) + "-" + to_string( trace_chunk_id++ );
+
+  trace_transfer_agent->request_upload( log_prefix + name + ".trace",
+                                        move( trace_chunk ) );
+
+  trace_chunk.clear();
 }
 
 void LambdaWorker::log_ray( const RayAction action,
@@ -81,28 +181,23 @@ void LambdaWorker::log_ray( const RayAction action,
   if ( !track_rays || !state.trackRay || action == RayAction::Traced )
     return;
 
-  ostringstream oss;
-
-  /* timestamp,pathId,hop,shadowRay,remainingBounces,workerId,treeletId,
-      action,bag */
-  oss << duration_cast<milliseconds>( system_clock::now().time_since_epoch() )
-           .count()
-      << ',' << state.sample.id << ',' << state.hop << ',' << state.isShadowRay
-      << ',' << static_cast<int>( state.remainingBounces ) << ',' << *worker_id
-      << ',' << state.CurrentTreelet() << ',';
-
-  // clang-format off
-    switch(action) {
-    case RayAction::Generated: oss << "Generated,";                break;
-    case RayAction::Traced:    oss << "Traced,";                   break;
-    case RayAction::Queued:    oss << "Queued,";                   break;
-    case RayAction::Bagged:    oss << "Bagged," << info.str("");   break;
-    case RayAction::Unbagged:  oss << "Unbagged," << info.str(""); break;
-    case RayAction::Finished:  oss << "Finished,";                 break;
-    }
-  // clang-format on
-
-  TLOG( RAY ) << oss.str();
+  TraceRecord record;
+  record.timestamp = duration_cast<microseconds>(
+                       system_clock::now().time_since_epoch() )
+                       .count();
+  record.kind = TraceRecord::Kind::Ray;
+  record.action = static_cast<uint8_t>( action );
+  record.path_id = state.sample.id;
+  record.hop = state.hop;
+  record.remaining_bounces = state.remainingBounces;
+  record.treelet_id = state.CurrentTreelet();
+  record.flags = state.isShadowRay ? TraceRecord::SHADOW_RAY : 0;
+
+  if ( action == RayAction::Bagged or action == RayAction::Unbagged ) {
+    record.set_bag( info );
+  }
+
+  trace_recorder.record( record );
 }
 
 void LambdaWorker::log_bag( const BagAction action, const RayBagInfo& info )
@@ -110,26 +205,13 @@ void LambdaWorker::log_bag( const BagAction action, const RayBagInfo& info )
   if ( !track_bags || !info.tracked )
     return;
 
-  ostringstream oss;
-
-  /* timestamp,bagTreeletId,bagWorkerId,bagId,thisWorkerId,count,size,action */
-  oss << duration_cast<milliseconds>( system_clock::now().time_since_epoch() )
-           .count()
-      << ',' << info.treelet_id << ',' << info.worker_id << ',' << info.bag_id
-      << ',' << *worker_id << ',' << info.ray_count << ',' << info.bag_size
-      << ',';
-
-  // clang-format off
-    switch(action) {
-    case BagAction::Created:   oss << "Created"; break;
-    case BagAction::Sealed:    oss << "Sealed"; break;
-    case BagAction::Submitted: oss << "Submitted"; break;
-    case BagAction::Enqueued:  oss << "Enqueued"; break;
-    case BagAction::Requested: oss << "Requested"; break;
-    case BagAction::Dequeued:  oss << "Dequeued"; break;
-    case BagAction::Opened:    oss << "Opened"; break;
-    }
-  // clang-format on
-
-  TLOG( BAG ) << oss.str();
+  TraceRecord record;
+  record.timestamp = duration_cast<microseconds>(
+                       system_clock::now().time_since_epoch() )
+                       .count();
+  record.kind = TraceRecord::Kind::Bag;
+  record.action = static_cast<uint8_t>( action );
+  record.set_bag( info );
+
+  trace_recorder.record( record );
 }
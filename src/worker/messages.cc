@@ -1,5 +1,9 @@
+#include <algorithm>
+
 #include "lambda-worker.hh"
 #include "messages/utils.hh"
+#include "storage/backend_local.hh"
+#include "util/lz4_frame.hh"
 
 using namespace std;
 using namespace chrono;
@@ -19,6 +23,83 @@ void LambdaWorker::handle_pending_messages()
   }
 }
 
+void LambdaWorker::get_and_setup_scene( const protobuf::GetObjects& objects )
+{
+  /* treelets wait for the objects they refer to */
+  dependencies_on_disk = false;
+
+  const auto local_scene = dynamic_cast<const LocalStorageBackend*>(
+    scene_storage_backend.get() );
+
+  for ( const protobuf::SceneObject& obj_proto : objects.objects() ) {
+    const SceneObject obj = from_protobuf( obj_proto );
+    const string name = object_name( obj );
+
+    /* a warm worker might have this one already */
+    auto preloaded_it = config.preloaded_objects.find( name );
+    if ( preloaded_it != config.preloaded_objects.end() ) {
+      store_scene_object( obj, string { preloaded_it->second } );
+      continue;
+    }
+
+    /* treelets of a file:// scene are loaded straight from the files */
+    if ( obj.key.type == ObjectType::Treelet and local_scene ) {
+      store_treelet(
+        obj.key.id,
+        LocalStorageBackend::map_object( local_scene->root() / name ) );
+      continue;
+    }
+
+    /* an earlier job on this machine might have left it behind */
+    if ( object_cache ) {
+      if ( obj.key.type == ObjectType::Treelet ) {
+        if ( auto mapped = object_cache->map( name ) ) {
+          store_treelet( obj.key.id, move( *mapped ) );
+          continue;
+        }
+      } else if ( auto cached = object_cache->get( name ) ) {
+        store_scene_object( obj, move( *cached ) );
+        continue;
+      }
+    }
+
+    if ( obj.key.type != ObjectType::Treelet ) {
+      pending_dependencies++;
+    }
+
+    /* the transfer agent decompresses it on the way in */
+    const auto id = scene_transfer_agent->request_download(
+      obj.compressed ? name + string { lz4_frame::SUFFIX } : name );
+    pending_scene_objects.insert( make_pair( id, move( obj ) ) );
+  }
+
+  if ( pending_dependencies == 0 ) {
+    start_treelet_loads();
+  }
+
+  finish_scene_setup();
+}
+
+void LambdaWorker::swap_treelet()
+{
+  if ( swap_treelet_rule ) {
+    swap_treelet_rule->cancel();
+    swap_treelet_rule.reset();
+  }
+
+  /* the ray-tracing threads hold on to the old treelets; an added treelet
+     loads while they keep going */
+  if ( not pending_swap->keep_old_treelets() ) {
+    shutdown_raytracing_threads();
+    raytracing_threads.clear();
+    treelets.clear();
+  }
+
+  /* other messages are held back until the new treelet is loaded */
+  scene_loaded = false;
+  get_and_setup_scene( pending_swap->objects() );
+}
+
 void LambdaWorker::process_message( const Message& message )
 {
 #ifndef NDEBUG
@@ -82,18 +163,7 @@ void LambdaWorker::process_message( const Message& message )
 
       protobuf::GetObjects proto;
       protoutil::from_string( message.payload(), proto );
-
-      for ( const protobuf::SceneObject& obj_proto : proto.objects() ) {
-        const SceneObject obj = from_protobuf( obj_proto );
-
-        const auto id = scene_transfer_agent->request_download(
-          scene_storage_backend.prefix()
-          + ( obj.alt_name.empty()
-                ? scene::GetObjectName( obj.key.type, obj.key.id )
-                : obj.alt_name ) );
-
-        pending_scene_objects.insert( make_pair( id, move( obj ) ) );
-      }
+      get_and_setup_scene( proto );
 
       break;
     }
@@ -107,14 +177,12 @@ void LambdaWorker::process_message( const Message& message )
     }
 
     case OpCode::ProcessRayBag: {
-      protobuf::RayBags proto;
-      protoutil::from_string( message.payload(), proto );
+      assigned_bags.decode( message.payload() );
 
-      for ( const protobuf::RayBagInfo& item : proto.items() ) {
-        RayBagInfo info { from_protobuf( item ) };
+      for ( const RayBagInfo& info : assigned_bags.items ) {
         const auto id
           = transfer_agent->request_download( info.str( ray_bags_key_prefix ) );
-        pending_ray_bags[id] = make_pair( Task::Download, info );
+        pending_ray_bags[id] = { Task::Download, info };
 
         log_bag( BagAction::Requested, info );
       }
@@ -122,7 +190,46 @@ void LambdaWorker::process_message( const Message& message )
       break;
     }
 
+    case OpCode::SwapTreelet: {
+      if ( is_accumulator or pending_swap ) {
+        throw runtime_error( "unexpected SwapTreelet message" );
+      }
+
+      pending_swap.emplace();
+      protoutil::from_string( message.payload(), *pending_swap );
+
+      /* the treelets we have stay, so there's nothing to wait for */
+      if ( pending_swap->keep_old_treelets() ) {
+        swap_treelet();
+        break;
+      }
+
+      /* the rays we already have for the old treelet are traced first; the
+         master doesn't send us any more of them */
+      swap_treelet_rule = loop.add_rule(
+        "Swap treelet",
+        bind( &LambdaWorker::swap_treelet, this ),
+        [this] {
+          return trace_queue_size == 0 and processed_queue_size == 0
+                 and receive_queue.empty()
+                 and none_of( pending_ray_bags.begin(),
+                              pending_ray_bags.end(),
+                              []( const auto& bag ) {
+                                return bag.second.task == Task::Download;
+                              } );
+        } );
+
+      break;
+    }
+
     case OpCode::FinishUp:
+      /* a swap that hasn't started yet is moot now */
+      if ( swap_treelet_rule ) {
+        swap_treelet_rule->cancel();
+        swap_treelet_rule.reset();
+        pending_swap.reset();
+      }
+
       finish_up_rule = loop.add_rule(
         "Finish up",
         [this]() {
@@ -131,6 +238,7 @@ void LambdaWorker::process_message( const Message& message )
           // making sure raytracing threads are done
           shutdown_raytracing_threads();
           shutdown_accumulation_threads();
+          shutdown_treelet_loaders();
 
           pbrt::AccumulatedStats pbrt_stats = pbrt::stats::GetThreadStats();
           for ( auto& thread_stats : raytracing_thread_stats ) {
@@ -12,6 +12,8 @@ using OpCode = Message::OpCode;
 
 void LambdaWorker::generate_rays( const Bounds2i& bounds )
 {
+  mark_first_ray();
+
   /* for ray tracking */
   bernoulli_distribution bd { config.ray_log_rate };
 
@@ -35,7 +37,7 @@ void LambdaWorker::generate_rays( const Bounds2i& bounds )
         trace_queue.enqueue( move( state_ptr ) );
       } else {
         log_ray( RayAction::Queued, *state_ptr );
-        out_queue[next_treelet].push( move( state_ptr ) );
+        out_queue[{ next_treelet, nullopt }].push( move( state_ptr ) );
         out_queue_size++;
       }
     }
@@ -49,9 +51,6 @@ void LambdaWorker::handle_trace_queue( const size_t idx )
   constexpr size_t RAYS_TO_NOTIFY = 1000;
   size_t ray_counter = 0;
 
-  // assuming only one treelet per worker
-  auto& treelet = *treelets.begin()->second;
-
   while ( true ) {
     trace_queue.wait_dequeue( ray_ptr );
 
@@ -71,6 +70,8 @@ void LambdaWorker::handle_trace_queue( const size_t idx )
       }
 
       auto& ray = *ray_ptr;
+      const TreeletId source = ray.CurrentTreelet();
+      auto& treelet = *treelets.at( source );
 
       log_ray( RayAction::Traced, ray );
       this->rays.terminated++;
@@ -78,7 +79,7 @@ void LambdaWorker::handle_trace_queue( const size_t idx )
       if ( not ray.toVisitEmpty() ) {
         processed_queue_size++;
         processed_queue.enqueue(
-          graphics::TraceRay( move( ray_ptr ), treelet ) );
+          { source, graphics::TraceRay( move( ray_ptr ), treelet ) } );
       } else if ( ray.hit ) {
         log_ray( RayAction::Finished, ray );
 
@@ -95,20 +96,20 @@ void LambdaWorker::handle_trace_queue( const size_t idx )
           // means that the path was terminated
           ray.toVisitHead = numeric_limits<uint8_t>::max();
           processed_queue_size++;
-          processed_queue.enqueue( move( ray_ptr ) );
+          processed_queue.enqueue( { source, move( ray_ptr ) } );
           continue;
         }
 
         if ( bounce_ray != nullptr ) {
           log_ray( RayAction::Generated, *bounce_ray );
           processed_queue_size++;
-          processed_queue.enqueue( move( bounce_ray ) );
+          processed_queue.enqueue( { source, move( bounce_ray ) } );
         }
 
         if ( shadow_ray != nullptr ) {
           log_ray( RayAction::Generated, *shadow_ray );
           processed_queue_size++;
-          processed_queue.enqueue( move( shadow_ray ) );
+          processed_queue.enqueue( { source, move( shadow_ray ) } );
         }
       } else {
         throw runtime_error( "invalid ray in trace queue" );
@@ -125,7 +126,7 @@ void LambdaWorker::handle_processed_queue()
     return;
   }
 
-  auto queue_ray = [this]( pbrt::RayStatePtr&& ray ) {
+  auto queue_ray = [this]( pbrt::RayStatePtr&& ray, const TreeletId source ) {
     const TreeletId next_treelet = ray->CurrentTreelet();
 
     if ( treelets.count( next_treelet ) ) {
@@ -133,18 +134,20 @@ void LambdaWorker::handle_processed_queue()
       trace_queue.enqueue( move( ray ) );
     } else {
       log_ray( RayAction::Queued, *ray );
-      out_queue[next_treelet].push( move( ray ) );
+      out_queue[{ next_treelet, source }].push( move( ray ) );
       out_queue_size++;
     }
 
     this->rays.generated++;
   };
 
-  pbrt::RayStatePtr ray_ptr;
+  TracedRay traced;
 
-  while ( processed_queue.try_dequeue( ray_ptr ) ) {
+  while ( processed_queue.try_dequeue( traced ) ) {
     processed_queue_size--;
+    mark_first_ray();
 
+    auto& ray_ptr = traced.ray;
     auto& ray = *ray_ptr;
 
     /* HACK */
@@ -169,10 +172,10 @@ void LambdaWorker::handle_processed_queue()
           finished_path_ids.push( ray.PathID() );
         }
       } else {
-        queue_ray( move( ray_ptr ) );
+        queue_ray( move( ray_ptr ), traced.source );
       }
     } else if ( not empty_visit or hit ) {
-      queue_ray( move( ray_ptr ) );
+      queue_ray( move( ray_ptr ), traced.source );
     } else if ( empty_visit ) {
       ray.Ld = 0.f;
 